@@ -0,0 +1,182 @@
+/*=======================================================================
+  bench - scaling benchmark of the simulator
+
+  usage: bench [-s sizes] [-t seconds] [-j threads] [-i isa] [-c files]
+               [-d dir] [-o file] [-k] [-n cache] [-r order]
+
+  For each size (gates, default 1000,10000,100000,1000000,10000000) a
+  synthetic circuit is generated into dir (default /tmp), then READ,
+  levelized and compiled, and simulated with random patterns, one gate
+  kernel block per pass, for at least the given time (default 1 s), on
+  the given number of threads (default 1, see THREADS) and gate kernel
+  (scalar, avx2 or avx512; default the widest supported, see SIMD), or
+  with -n by the native simulator compiled into the cache directory
+  (see CODEGEN), whose generation or loading then counts in lev_s.
+  -c benchmarks the given comma separated circuit files instead of
+  generated ones. -r renumbers the nodes (level or dfs, see REORDER)
+  after levelizing; the renumbering counts in lev_s. Each circuit
+  prints one JSON line:
+
+  {"circuit":..,"threads":..,"isa":..,"native":..,"order":..,"gates":..,"nodes":..,"edges":..,"levels":..,
+   "file_bytes":..,"read_s":..,"lev_s":..,"patterns":..,"sim_s":..,
+   "patterns_per_s":..,"gate_evals_per_s":..,"peak_kb":..}
+
+  gates counts the tape ops that are not branches. gate_evals_per_s
+  counts one evaluation per gate or branch per pattern.
+  peak_kb is the peak resident size of the process so far; each circuit
+  is cleared before the next is read. The generated circuit files are
+  removed afterwards unless -k is given.
+=======================================================================*/
+#include "readckt.h"
+#include "generator.h"
+
+using namespace std;
+
+static void usage(){
+    fprintf(stderr, "usage: bench [-s sizes] [-t seconds] [-j threads] [-i isa] [-c files]\n");
+    fprintf(stderr, "             [-d dir] [-o file] [-k] [-n cache] [-r order]\n");
+    exit(1);
+}
+
+static int Order = -1;          /* renumbering of -r, -1 for none */
+
+/*-----------------------------------------------------------------------
+input: circuit file, or NULL to generate one of n gates, output stream,
+       minimum simulation time, directory, keep flag
+output: 0 on success, -1 on failure
+called by: main
+description:
+    Runs the benchmark of one circuit and prints its JSON line.
+-----------------------------------------------------------------------*/
+static int benchone(const char *file, int n, FILE *fp, double mintime, const char *dir, int keep){
+    struct genparam g;
+    char name[MAXNAME], line[MAXNAME + 1], cname[MAXNAME + 4];
+    struct stat st;
+    double t0, tread, tlev, tsim;
+    long long npat = 0;
+    uint64_t s = 0x9e3779b97f4a7c15ULL;
+    int i;
+
+    if(file) {
+        snprintf(name, sizeof(name), "%s", file);
+        keep = 1;
+        if(stat(name, &st) < 0) {
+            fprintf(stderr, "Error: cannot read %s\n", name);
+            return -1;
+        }
+    }
+    else {
+        snprintf(name, sizeof(name), "%s/bench_%d.ckt", dir, n);
+        gendefault(g, n);
+        if(gencircuit(name, g) < 0 || stat(name, &st) < 0) {
+            fprintf(stderr, "Error: cannot write %s\n", name);
+            return -1;
+        }
+    }
+
+    /* READ takes its file name from cp, newline terminated */
+    snprintf(line, sizeof(line), "%s\n", name);
+    cp = line;
+    t0 = seconds();
+    cread();
+    tread = seconds() - t0;
+    if(!keep) {
+        unlink(name);
+        snprintf(cname, sizeof(cname), "%s.rcb", name);     /* binary cache written by READ */
+        unlink(cname);
+    }
+    if(Gstate != CKTLD) return -1;
+
+    t0 = seconds();
+    if(levelize() < 0 || compile() < 0 || (Order >= 0 && renumber(Order) < 0)) {
+        clear();
+        return -1;
+    }
+    if(!Nativedir.empty() && loadnative(0) < 0) {
+        clear();
+        return -1;
+    }
+    tlev = seconds() - t0;
+    for(n = 0, i = 0; i < Ntape; i++) n += Tape[i].op != BRCH;
+
+    int k, nw = simdwords();
+    vector<uint64_t> val((size_t) Nnodes * nw, 0);
+    t0 = seconds();
+    do {
+        for(i = 0; i < Npi; i++)
+            for(k = 0; k < nw; k++) {
+                s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+                val[(size_t) Pinput[i]->indx * nw + k] = s;
+            }
+        tapesimw(&val[0], nw);
+        npat += 64 * nw;
+    } while((tsim = seconds() - t0) < mintime);
+
+    fprintf(fp, "{\"circuit\":\"%s\",\"threads\":%d,\"isa\":\"%s\",\"native\":%d,\"order\":\"%s\",\"gates\":%d,\"nodes\":%d,\"edges\":%d,\"levels\":%d,\"file_bytes\":%lld,"
+            "\"read_s\":%.6f,\"lev_s\":%.6f,\"patterns\":%lld,\"sim_s\":%.6f,"
+            "\"patterns_per_s\":%.1f,\"gate_evals_per_s\":%.1f,\"peak_kb\":%ld}\n",
+            name, Nthreads, isaname[Simd], Native != NULL, Order == ORD_LEVEL ? "level" : Order == ORD_DFS ? "dfs" : "file", n, Nnodes, Nedges, Nlevels, (long long) st.st_size, tread, tlev, npat, tsim,
+            npat / tsim, (double) npat * Ntape / tsim, peakmemory());
+    fflush(fp);
+    clear();
+    return 0;
+}
+
+int main(int argc, char **argv){
+    const char *sizes = "1000,10000,100000,1000000,10000000", *dir = "/tmp", *files = NULL, *p;
+    char file[MAXNAME];
+    FILE *fp = stdout;
+    double mintime = 1.0;
+    int c, keep = 0, n, bad = 0, isa;
+    char *e;
+
+    while((c = getopt(argc, argv, "s:t:j:i:c:d:o:kn:r:")) != -1) {
+        switch(c) {
+            case 's': sizes = optarg; break;
+            case 't': mintime = atof(optarg); break;
+            case 'j': setthreads(atoi(optarg)); break;
+            case 'i':
+                for(isa = 0; isa < NISA && strcasecmp(optarg, isaname[isa]); isa++) ;
+                if(isa == NISA || setsimd(isa) < 0) {
+                    fprintf(stderr, "Error: kernel %s is not supported\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'd': dir = optarg; break;
+            case 'o':
+                if((fp = fopen(optarg, "w")) == NULL) {
+                    fprintf(stderr, "Error: cannot write %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k': keep = 1; break;
+            case 'n': Nativedir = optarg; break;
+            case 'c': files = optarg; break;
+            case 'r':
+                if(strcasecmp(optarg, "level") == 0) Order = ORD_LEVEL;
+                else if(strcasecmp(optarg, "dfs") == 0) Order = ORD_DFS;
+                else usage();
+                break;
+            default: usage();
+        }
+    }
+    Verbose = 0;
+    for(p = files; p && *p; p = *e ? e + 1 : e) {
+        for(e = (char *) p; *e && *e != ','; e++) ;
+        snprintf(file, sizeof(file), "%.*s", (int) (e - p), p);
+        if(benchone(file, 0, fp, mintime, dir, 1) < 0) {
+            fprintf(stderr, "Error: benchmark of %s failed\n", file);
+            bad = 1;
+        }
+    }
+    for(p = files ? "" : sizes; *p; p = *e ? e + 1 : e) {
+        n = strtol(p, &e, 10);
+        if(e == p || n <= 0 || (*e && *e != ',')) usage();
+        if(benchone(NULL, n, fp, mintime, dir, keep) < 0) {
+            fprintf(stderr, "Error: benchmark of %d gates failed\n", n);
+            bad = 1;
+        }
+    }
+    if(fp != stdout) fclose(fp);
+    return bad;
+}
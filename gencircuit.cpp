@@ -0,0 +1,50 @@
+/*=======================================================================
+  gencircuit - write a synthetic circuit in the "self" format
+
+  usage: gencircuit -n gates [-i pis] [-d depth] [-f maxfanout]
+                    [-k maxfanin] [-m mix] [-s seed] -o file
+
+  The mix lists gate weights, e.g. "nand:3,nor:2,xor:1,not:1". See
+  generator.cpp for how the circuit is built.
+=======================================================================*/
+#include "readckt.h"
+#include "generator.h"
+
+static void usage(){
+    fprintf(stderr, "usage: gencircuit -n gates [-i pis] [-d depth] [-f maxfanout]\n");
+    fprintf(stderr, "                  [-k maxfanin] [-m mix] [-s seed] -o file\n");
+    exit(1);
+}
+
+int main(int argc, char **argv){
+    struct genparam g;
+    const char *out = NULL, *mix = NULL;
+    int c, n = 0, npi = 0;
+
+    gendefault(g, 0);
+    while((c = getopt(argc, argv, "n:i:d:f:k:m:s:o:")) != -1) {
+        switch(c) {
+            case 'n': n = atoi(optarg); break;
+            case 'i': npi = atoi(optarg); break;
+            case 'd': g.depth = atoi(optarg); break;
+            case 'f': g.maxfout = atoi(optarg); break;
+            case 'k': g.maxfin = atoi(optarg); break;
+            case 'm': mix = optarg; break;
+            case 's': g.seed = strtoull(optarg, NULL, 0); break;
+            case 'o': out = optarg; break;
+            default: usage();
+        }
+    }
+    if(n <= 0 || out == NULL) usage();
+    g.ngates = n;
+    g.npi = npi > 0 ? npi : n / 20 + 8;
+    if(mix && genmix(g, mix) < 0) {
+        fprintf(stderr, "Error: malformed gate mix %s\n", mix);
+        return 1;
+    }
+    if(gencircuit(out, g) < 0) {
+        fprintf(stderr, "Error: cannot write %s\n", out);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*=======================================================================
+  Synthetic circuit generator, see generator.h.
+
+  Gates are spread over the levels 1..depth, at least one per level, and
+  numbered in level order after the primary inputs. The first fanin of a
+  gate comes from the level right below it, so the depth is exact; the
+  other fanins come from any lower level. Stems are used in level order
+  before random ones are drawn, so few lines are left dangling. A stem
+  with more than one fanout drives a BRCH node per fanout, as in the
+  ISCAS translations, and gates without fanout become primary outputs.
+=======================================================================*/
+#include "readckt.h"
+#include "generator.h"
+
+using namespace std;
+
+/* xorshift64* generator, seeded through splitmix64 */
+struct genrand {
+    uint64_t s;
+
+    genrand(uint64_t seed){
+        uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        s = (z ^ (z >> 31)) | 1;
+    }
+    uint64_t next(){
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 0x2545f4914f6cdd1dULL;
+    }
+    /* uniform in [0, n) */
+    uint32_t below(uint32_t n){
+        return (uint32_t) (((next() >> 32) * n) >> 32);
+    }
+};
+
+/*-----------------------------------------------------------------------
+input: parameters to fill, number of gates
+output: nothing
+called by: gencircuit, bench
+description:
+    Sets the default parameters for a circuit of ngates gates: one PI per
+    20 gates, fanin and fanout limits of 4 and a NAND/AND heavy gate mix.
+-----------------------------------------------------------------------*/
+void gendefault(struct genparam &g, int ngates){
+    memset(&g, 0, sizeof(g));
+    g.ngates = ngates;
+    g.npi = ngates / 20 + 8;
+    g.depth = 0;
+    g.maxfout = 4;
+    g.maxfin = 4;
+    g.mix[AND] = 3;
+    g.mix[NAND] = 3;
+    g.mix[OR] = 2;
+    g.mix[NOR] = 2;
+    g.mix[XOR] = 1;
+    g.mix[XNOR] = 1;
+    g.mix[NOT] = 1;
+    g.mix[BUFFER] = 1;
+    g.seed = 1;
+}
+
+/*-----------------------------------------------------------------------
+input: parameters, gate mix such as "nand:3,nor:1,not:1"
+output: 0 on success, -1 on a malformed mix
+called by: gencircuit
+description:
+    Replaces the gate mix of g. Gate names are those printed by PC (AND,
+    NAND, OR, NOR, XOR, XNOR, NOT, BUFFER), in either case; gates not
+    named get weight 0.
+-----------------------------------------------------------------------*/
+int genmix(struct genparam &g, const char *spec){
+    int t, w, sum = 0;
+    const char *p = spec, *colon;
+
+    memset(g.mix, 0, sizeof(g.mix));
+    while(*p) {
+        if((colon = strchr(p, ':')) == NULL) return -1;
+        for(t = XOR; t <= BUFFER; t++)
+            if(gname(t).size() == (size_t)(colon - p) && strncasecmp(gname(t).c_str(), p, colon - p) == 0) break;
+        if(t > BUFFER) return -1;
+        w = strtol(colon + 1, (char **) &p, 10);
+        if(w < 0 || (*p && *p++ != ',')) return -1;
+        g.mix[t] = w;
+        sum += w;
+    }
+    return sum > 0 ? 0 : -1;
+}
+
+/*-----------------------------------------------------------------------
+input: output file name, parameters
+output: 0 on success, -1 if the file cannot be written
+called by: gencircuit, bench
+description:
+    Generates the circuit described by g and writes it to name. See the
+    top of this file for the construction.
+-----------------------------------------------------------------------*/
+int gencircuit(const char *name, const struct genparam &g){
+    int ng = g.ngates, npi = g.npi, depth = g.depth, nn, i, j, k, l, t, sum;
+    int maxfin = g.maxfin < 2 ? 2 : g.maxfin, maxfout = g.maxfout < 1 ? 1 : g.maxfout;
+    genrand rnd(g.seed);
+    vecwriter out;
+
+    if(ng < 1 || npi < 1) return -1;
+    if(depth <= 0) for(depth = 4, i = ng; i > 1; i >>= 1) depth += 4;
+    if(depth > ng) depth = ng;
+    nn = npi + ng;
+
+    /* gates per level, then the first node of each level */
+    vector<int> levstart(depth + 2, 0), nlev(nn, 0);
+    for(i = 0; i < ng; i++) levstart[(i < depth ? i + 1 : 1 + rnd.below(depth)) + 1]++;
+    levstart[1] = npi;
+    for(l = 1; l <= depth; l++) levstart[l + 1] += levstart[l];
+    for(l = 1; l <= depth; l++)
+        for(i = levstart[l]; i < levstart[l + 1]; i++) nlev[i] = l;
+
+    /* gate types and fanins */
+    vector<unsigned char> type(nn, IPT);
+    vector<uint32_t> finoff(nn + 1, 0), fsrc, ford, fcount(nn, 0);
+    vector<int> cursor(levstart.begin(), levstart.end() - 1);
+    fsrc.reserve((size_t) ng * 3);
+    ford.reserve((size_t) ng * 3);
+    for(sum = 0, t = XOR; t <= BUFFER; t++) sum += g.mix[t];
+    if(sum <= 0) return -1;
+
+    for(i = npi; i < nn; i++) {
+        int lv = nlev[i], lo = levstart[lv - 1], lim = levstart[lv], nf, w = rnd.below(sum);
+
+        for(t = XOR; w >= g.mix[t]; t++) w -= g.mix[t];
+        type[i] = t;
+        nf = (t == NOT || t == BUFFER) ? 1 : 2 + rnd.below(maxfin - 1);
+        if(nf > lim) nf = lim;
+        if(nf < 2 && t != NOT && t != BUFFER) type[i] = BUFFER;
+        finoff[i] = fsrc.size();
+        for(j = 0; j < nf; j++) {
+            uint32_t s = 0;
+            int found = 0, tries;
+
+            if(j == 0) {
+                while(cursor[lv - 1] < lim && fcount[cursor[lv - 1]]) cursor[lv - 1]++;
+                if(cursor[lv - 1] < lim) s = cursor[lv - 1]++, found = 1;
+            }
+            for(tries = 0; !found && tries < 64; tries++) {
+                s = j == 0 ? lo + rnd.below(lim - lo) : rnd.below(lim);
+                if(fcount[s] >= (uint32_t) maxfout) continue;
+                for(found = 1, k = finoff[i]; k < (int) fsrc.size(); k++)
+                    if(fsrc[k] == s) found = 0;
+            }
+            if(!found) {
+                /* every candidate is saturated, exceed the fanout limit */
+                s = j == 0 ? lo + rnd.below(lim - lo) : rnd.below(lim);
+                for(k = finoff[i]; k < (int) fsrc.size(); k++)
+                    if(fsrc[k] == s) break;
+                if(k < (int) fsrc.size()) continue;
+            }
+            ford.push_back(fcount[s]++);
+            fsrc.push_back(s);
+        }
+        if(fsrc.size() - finoff[i] < 2 && type[i] != NOT && type[i] != BUFFER) type[i] = BUFFER;
+    }
+    finoff[nn] = fsrc.size();
+
+    /* numbers: node i is i+1, the branches of stem s follow at brbase[s] */
+    vector<uint32_t> brbase(nn);
+    uint32_t next = nn + 1;
+    for(i = 0; i < nn; i++) {
+        brbase[i] = next;
+        if(fcount[i] > 1) next += fcount[i];
+    }
+
+    if(out.open(name) < 0) return -1;
+    for(i = 0; i < nn; i++) {
+        if(i < npi) {
+            out.putint(PI); out.put(' '); out.putint(i + 1); out.put(' ');
+            out.putint(IPT); out.put(' '); out.putint(fcount[i]); out.put(' '); out.putint(0);
+        }
+        else {
+            out.putint(fcount[i] ? GATE : PO); out.put(' '); out.putint(i + 1); out.put(' ');
+            out.putint(type[i]); out.put(' '); out.putint(fcount[i]); out.put(' ');
+            out.putint(finoff[i + 1] - finoff[i]);
+            for(k = finoff[i]; k < (int) finoff[i + 1]; k++) {
+                uint32_t s = fsrc[k];
+                out.put(' ');
+                out.putint(fcount[s] > 1 ? brbase[s] + ford[k] : s + 1);
+            }
+        }
+        out.put('\n');
+        if(fcount[i] > 1) for(j = 0; j < (int) fcount[i]; j++) {
+            out.putint(GATE); out.put(' '); out.putint(brbase[i] + j); out.put(' ');
+            out.putint(BRCH); out.put(' '); out.putint(1); out.put(' ');
+            out.putint(1); out.put(' '); out.putint(i + 1); out.put('\n');
+        }
+    }
+    return out.close();
+}
@@ -0,0 +1,27 @@
+/*=======================================================================
+  Synthetic circuit generator.
+
+  Writes a random levelized combinational circuit in the "self" format
+  read by READ, for benchmarking the simulator at sizes beyond the ISCAS
+  circuits. The same parameters and seed always give the same file.
+=======================================================================*/
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+
+struct genparam {
+    int ngates;                /* number of logic gates (branches not counted) */
+    int npi;                   /* number of primary inputs */
+    int depth;                 /* logic depth in gates, 0 for about 4*log2(ngates) */
+    int maxfout;               /* fanout limit of a stem */
+    int maxfin;                /* fanin limit of a multi-input gate */
+    int mix[10];               /* relative weight of each e_gtype */
+    uint64_t seed;             /* random seed */
+};
+
+void gendefault(struct genparam &g, int ngates);
+int genmix(struct genparam &g, const char *spec);
+int gencircuit(const char *name, const struct genparam &g);
+
+#endif
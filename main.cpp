@@ -1,5 +1,5 @@
+#include "readckt.h"
 
-#include "readckt.cpp"
 int main()
 {
    int com;
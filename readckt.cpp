@@ -52,75 +52,86 @@ lev()
 }
 =======================================================================*/
 
-#include <stdio.h>
-#include <iostream>
-#include <string>
-#include <string.h>
-#include <ctype.h>
-#include <cstring>
-#include <stdlib.h>
-#include <vector>
-#include <fstream>
-#include <sstream>
-#include <algorithm>
+#include "readckt.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <dlfcn.h>
+#include <limits.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <queue>
+#include <unordered_set>
+#include <functional>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-#define MAXLINE 10000               /* Input buffer size */
-#define MAXNAME 10000               /* File name size */
-
-#define Upcase(x) ((isalpha(x) && islower(x))? toupper(x) : (x))
-#define Lowcase(x) ((isalpha(x) && isupper(x))? tolower(x) : (x))
-
-enum e_com {READ, PC, HELP, QUIT,LEV,LOGICSIM};
-enum e_state {EXEC, CKTLD};         /* Gstate values */
-enum e_ntype {GATE, PI, FB, PO};    /* column 1 of circuit format */
-enum e_gtype {IPT, BRCH, XOR, OR, NOR, NOT, NAND, AND,XNOR, BUFFER};   /* gate types */
-
-struct cmdstruc {
-   char name[MAXNAME];        /* command syntax */
-   void (*fptr)();            /* function pointer of the commands */
-   enum e_state state;        /* execution state sequence */
-};
-
-typedef struct n_struc {
-    unsigned indx;             /* node index(from 0 to NumOfLine - 1 */
-    unsigned num;              /* line number(May be different from indx */
-    enum e_ntype ntype;
-    enum e_gtype type;         /* gate type */
-    unsigned fin;              /* number of fanins */
-    unsigned fout;             /* number of fanouts */
-    struct n_struc **unodes;   /* pointer to array of up nodes */
-    struct n_struc **dnodes;   /* pointer to array of down nodes */
-    int level;                 /* level of the gate output */
-	int value;				   /*value for each node*/
-} NSTRUC;                     
-/*===========Functions for sim================*/
-void readfile();
-void extractfilename();
-void circuit_value_calculation();
-void outfilewriting();
 string inputFilename;
 string outputFilename;
 
 /*----------------- Command definitions ----------------------------------*/
-#define NUMFUNCS 6
-void cread(), pc(), help(), quit(),lev(),logicsim();
 struct cmdstruc command[NUMFUNCS] = {
    {"READ", cread, EXEC},
    {"PC", pc, CKTLD},
    {"HELP", help, EXEC},
    {"QUIT", quit, EXEC},
    {"LEV", lev, CKTLD},
-   {"LOGICSIM",logicsim,CKTLD}
+   {"LOGICSIM",logicsim,CKTLD},
+   {"FAULTSIM",faultsim,CKTLD},
+   {"FCOLLAPSE",fcollapse,CKTLD},
+   {"STATS",stats,EXEC},
+   {"VERBOSE",verbose,EXEC},
+   {"THREADS",threads,EXEC},
+   {"SIMD",simd,EXEC},
+   {"CODEGEN",codegen,EXEC},
+   {"REORDER",reorder,CKTLD},
+   {"USE",cuse,EXEC},
+   {"LIST",clist,EXEC},
+   {"DROP",cdrop,EXEC},
+   {"BUDGET",cbudget,EXEC},
+   {"SERVE",serve,EXEC},
+   {"RANDSIM",randsim,CKTLD},
+   {"ECO",eco,CKTLD}
 };
 
+/*----------------- Instrumentation --------------------------------------*/
+const char *phasename[NPHASES] = {"READ", "LEV", "LOGICSIM", "FAULTSIM", "FCOLLAPSE"};
+struct statstruc Stats;
+int Verbose = 1;                /* 0: results only, 1: progress, 2: per-gate trace */
+
 /*------------------------------------------------------------------------*/
 enum e_state Gstate = EXEC;     /* global exectution sequence */
 NSTRUC *Node;                   /* dynamic array of nodes */
 NSTRUC **Pinput;                /* pointer to array of primary inputs */
 NSTRUC **Poutput;               /* pointer to array of primary outputs */
+uint64_t *Pvalue;               /* 64 packed pattern values per node (LOGICSIM -P) */
+int Nlevels;                    /* number of levels, 0 if not levelized */
+int *Levstart;                  /* first Levnode entry of each level */
+int *Levnode;                   /* node indices bucketed by level */
+TSTRUC *Tape;                   /* compiled simulation tape, level order */
+uint32_t *Tapefin;              /* fanin slots of the tape ops */
+int Ntape;                      /* number of tape ops */
+int *Tapelev;                   /* first Tape op of each level, NULL if not compiled */
+int Nphase;                     /* number of barrier phases of the threaded simulator */
+int *Phasestart;                /* first Tape op of each phase */
+unsigned char *Phasepar;        /* 1 if the phase is split across the threads */
+int Nthreads = 1;               /* simulation threads, see THREADS */
+nativefn Native;                /* loaded native simulator, NULL if none (see CODEGEN) */
+string Nativedir;               /* its cache directory, empty while CODEGEN is off */
+CSTRUC Ckt;                     /* CSR topology of the circuit */
+NSTRUC **Upool;                 /* storage of all Node.unodes arrays */
+NSTRUC **Dpool;                 /* storage of all Node.dnodes arrays */
+int *Pislot;                    /* PI node number -> index in Pinput, -1 otherwise */
+int Npislot;                    /* size of Pislot (largest PI number + 1) */
+int *Fileorder;                 /* index of the i-th node of the file, NULL until REORDER */
 int Nnodes;                     /* number of nodes */
+int Nedges;                     /* number of fanin (= fanout) edges */
 int Npi;                        /* number of primary inputs */
 int Npo;                        /* number of primary outputs */
 int Done = 0;                   /* status bit to terminate program */
@@ -188,14 +199,64 @@ description:
 void help(){
     printf("READ filename - ");
     printf("read in circuit file and creat all data structures\n");
+    printf("    saves them to filename.rcb, mapped instead while the file is unchanged\n");
     printf("PC - ");
     printf("print circuit information\n");
     printf("HELP - ");
     printf("print this help information\n");
     printf("QUIT - ");
     printf("stop and exit\n");
-    printf("LOGICSIM - ");
+    printf("LOGICSIM [-P|-E|-S|-X] infile outfile - ");
     printf("simulate the logic circuit and output the results\n");
+    printf("    -P: bit-parallel mode, 64 vectors per pass\n");
+    printf("    -E: event-driven mode, reports gate evaluations per vector\n");
+    printf("    -S: sharded mode, vectors split across the THREADS threads\n");
+    printf("    -X: three-valued mode, unlisted or X inputs are X (X reads as 0 otherwise)\n");
+    printf("LOGICSIM -M window infile sigfile [goldensig] - ");
+    printf("compact the PO values into MISR signatures, one per window of vectors\n");
+    printf("    goldensig: report the windows whose signatures differ from it\n");
+    printf("LOGICSIM -W window sigfile infile outfile - ");
+    printf("simulate only that window of a -M run, with the PO lines\n");
+    printf("LOGICSIM -T [-D delayfile] infile outfile trfile - ");
+    printf("timed simulation with inertial gate delays (1, branches 0)\n");
+    printf("    delayfile: \"gate delay\" or \"num delay\" lines; trfile: num,transitions,glitches per vector\n");
+    printf("LOGICSIM -O po[,po...] [-P|-X] infile outfile - ");
+    printf("simulate only the fan-in cone of the listed POs\n");
+    printf("RANDSIM [-S seed] n outfile - ");
+    printf("simulate n random patterns (K, M, G suffix), write node probabilities and activities\n");
+    printf("FAULTSIM infile outfile [faultfile] - ");
+    printf("stuck-at fault simulation of the vectors in infile\n");
+    printf("    faultfile: fault list to simulate, e.g. from FCOLLAPSE\n");
+    printf("FCOLLAPSE outfile - ");
+    printf("write the fault list collapsed by equivalence and dominance\n");
+    printf("STATS [-R] [-J [file]] - ");
+    printf("print phase timers and counters\n");
+    printf("    -J: as JSON, to file if given; -R: reset afterwards\n");
+    printf("VERBOSE [level] - ");
+    printf("0: results only, 1: progress (default), 2: per-gate trace\n");
+    printf("THREADS [n] - ");
+    printf("set the simulation threads, 0 for one per core (default 1)\n");
+    printf("SIMD [scalar|avx2|avx512|auto|-C] - ");
+    printf("gate kernel of LOGICSIM -P/-S/-X (default: widest supported)\n");
+    printf("    -C: check the kernels against gatefunction()\n");
+    printf("REORDER [level|dfs] - ");
+    printf("renumber the nodes for memory locality (default level)\n");
+    printf("USE circuit - ");
+    printf("make a circuit parked by READ current (number in LIST or file)\n");
+    printf("LIST - ");
+    printf("list the loaded circuits\n");
+    printf("DROP [circuit|-A] - ");
+    printf("free a parked circuit, all of them (-A) or the current one\n");
+    printf("BUDGET [MB] - ");
+    printf("memory for loaded circuits, least recently used dropped first (0: no limit)\n");
+    printf("SERVE socket - ");
+    printf("serve simulation requests of simclient on a Unix domain socket\n");
+    printf("ECO TYPE n gate | ADD n f | DEL n f | BUF n d newnum - ");
+    printf("edit the circuit: gate type of n, fanin f of n added/removed, buffer newnum on fanout d of n\n");
+    printf("    updates levels and values of the last LOGICSIM vector in the fanout cone only\n");
+    printf("CODEGEN [-F] [dir] | CODEGEN OFF - ");
+    printf("compile the circuit to a native simulator cached in dir (default $XDG_CACHE_HOME/readckt)\n");
+    printf("    -F: recompile even if cached; OFF: back to the gate kernels\n");
 }
 
 
@@ -210,26 +271,164 @@ void quit(){
     Done = 1;
 }
 
+/*-----------------------------------------------------------------------
+input: nothing
+output: monotonic time in seconds
+called by: phasetimer, faultsim
+-----------------------------------------------------------------------*/
+double seconds(){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+phasetimer::phasetimer(enum e_phase p) : ph(p), t0(seconds()) { Stats.calls[ph]++; }
+phasetimer::~phasetimer(){ Stats.time[ph] += seconds() - t0; }
+
+/*-----------------------------------------------------------------------
+input: size in bytes (count and size for ccalloc)
+output: allocated memory
+called by: allocate, cread, levelize, compile
+description:
+    malloc/calloc for the circuit data structures, counted in Stats.
+-----------------------------------------------------------------------*/
+void *cmalloc(size_t size){
+    Stats.allocs++;
+    Stats.allocbytes += size;
+    return malloc(size);
+}
+
+void *ccalloc(size_t n, size_t size){
+    Stats.allocs++;
+    Stats.allocbytes += n * size;
+    return calloc(n, size);
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: peak resident memory in KB
+called by: stats
+-----------------------------------------------------------------------*/
+long peakmemory(){
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    STATS [-R] [-J [file]]: prints the phase timers, the counters and the
+    peak memory. -J writes them as one JSON object instead, to file if a
+    name follows; -R clears the timers and counters afterwards.
+-----------------------------------------------------------------------*/
+void stats(){
+    stringstream st(cp);
+    string arg, jsonfile;
+    int i, json = 0, reset = 0;
+    FILE *fp = stdout;
+
+    while(st>>arg) {
+        if(arg == "-J" || arg == "-j") json = 1;
+        else if(arg == "-R" || arg == "-r") reset = 1;
+        else if(json) jsonfile = arg;
+    }
+    if(json) {
+        if(!jsonfile.empty() && (fp = fopen(jsonfile.c_str(), "w")) == NULL) {
+            cerr<<"Cannot open a output file to write"<<endl;
+            return;
+        }
+        fprintf(fp, "{\"phases\": {");
+        for(i = 0; i < NPHASES; i++)
+            fprintf(fp, "%s\"%s\": {\"seconds\": %.6f, \"calls\": %lld}", i ? ", " : "",
+                    phasename[i], Stats.time[i], Stats.calls[i]);
+        fprintf(fp, "}, \"gate_evaluations\": %lld, \"vectors\": %lld, \"bytes_parsed\": %lld, "
+                "\"allocations\": %lld, \"allocated_bytes\": %lld, \"peak_memory_kb\": %ld, "
+                "\"nodes\": %d, \"levels\": %d}\n", Stats.gateevals, Stats.vectors, Stats.bytes,
+                Stats.allocs, Stats.allocbytes, peakmemory(), Gstate >= CKTLD ? Nnodes : 0, Nlevels);
+        if(fp != stdout) fclose(fp);
+    }
+    else {
+        printf("Phase       Calls    Seconds\n");
+        printf("---------- ------ ----------\n");
+        for(i = 0; i < NPHASES; i++)
+            printf("%-10s %6lld %10.6f\n", phasename[i], Stats.calls[i], Stats.time[i]);
+        printf("Gate evaluations = %lld\n", Stats.gateevals);
+        printf("Vectors simulated = %lld\n", Stats.vectors);
+        printf("Bytes parsed = %lld\n", Stats.bytes);
+        printf("Allocations = %lld (%lld bytes)\n", Stats.allocs, Stats.allocbytes);
+        printf("Peak memory = %ld KB\n", peakmemory());
+    }
+    if(reset) memset(&Stats, 0, sizeof(Stats));
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    VERBOSE [level]: sets or shows the verbosity level.
+-----------------------------------------------------------------------*/
+void verbose(){
+    int level;
+
+    if(sscanf(cp, "%d", &level) == 1) Verbose = level;
+    if(Verbose > MAXVERBOSE)
+        printf("==> verbosity %d, levels above %d are compiled out", Verbose, MAXVERBOSE);
+    else printf("==> verbosity %d", Verbose);
+}
+
 /*======================================================================*/
 
 /*-----------------------------------------------------------------------
 input: nothing
 output: nothing
-called by: cread
+called by: cread, bench
 description:
     This routine clears the memory space occupied by the previous circuit
-    before reading in new one. It frees up the dynamic arrays Node.unodes,
-    Node.dnodes, Node.flist, Node, Pinput, Poutput, and Tap.
+    before reading in new one. It frees up the dynamic arrays Node, the
+    unodes/dnodes pools, the CSR arrays, Pinput and Poutput, the cached
+    output cones and the arrays of ECO edits.
 -----------------------------------------------------------------------*/
 void clear(){
-    int i;
-    for(i = 0; i<Nnodes; i++) {
-        free(Node[i].unodes);
-        free(Node[i].dnodes);
-    }
+    free(Upool);
+    free(Dpool);
+    freeckt();
     free(Node);
     free(Pinput);
     free(Poutput);
+    free(Pvalue);
+    Upool = Dpool = NULL;
+    Node = NULL;
+    Pinput = Poutput = NULL;
+    Pvalue = NULL;
+    Nnodes = Nedges = Npi = Npo = Ntape = 0;
+    free(Pislot);
+    Pislot = NULL;
+    Npislot = 0;
+    free(Fileorder);
+    Fileorder = NULL;
+    free(Levstart);
+    free(Levnode);
+    Levstart = Levnode = NULL;
+    Nlevels = 0;
+    free(Tape);
+    free(Tapefin);
+    free(Tapelev);
+    free(Phasestart);
+    free(Phasepar);
+    Tape = NULL;
+    Tapefin = NULL;
+    Tapelev = NULL;
+    Phasestart = NULL;
+    Phasepar = NULL;
+    freecones();
+    freenative();
+    freeeco();
     Gstate = EXEC;
 }
 
@@ -240,20 +439,109 @@ called by: cread
 description:
     This routine allocatess the memory space required by the circuit
     description data structure. It allocates the dynamic arrays Node,
-    Node.flist, Node, Pinput, Poutput, and Tap. It also set the default
-    tap selection and the fanin and fanout to 0.
+    Pinput, Poutput, the CSR arrays for Nedges edges and the pools that
+    back Node.unodes/Node.dnodes, so the number of allocations does not
+    depend on the circuit size. It also sets the fanin and fanout to 0.
+    With csr 0 the CSR arrays are left alone (mapped by loadcache()).
 -----------------------------------------------------------------------*/
-void allocate(){
+void allocate(int csr){
     int i;
-    Node = (NSTRUC *) malloc(Nnodes * sizeof(NSTRUC));
-    Pinput = (NSTRUC **) malloc(Npi * sizeof(NSTRUC *));
-    Poutput = (NSTRUC **) malloc(Npo * sizeof(NSTRUC *));
+    Node = (NSTRUC *) cmalloc(Nnodes * sizeof(NSTRUC));
+    Upool = (NSTRUC **) cmalloc(Nedges * sizeof(NSTRUC *));
+    Dpool = (NSTRUC **) cmalloc(Nedges * sizeof(NSTRUC *));
+    if(csr) {
+        Ckt.finoff = (uint32_t *) ccalloc(Nnodes + 1, sizeof(uint32_t));
+        Ckt.fanin = (uint32_t *) cmalloc(Nedges * sizeof(uint32_t));
+        Ckt.foutoff = (uint32_t *) ccalloc(Nnodes + 1, sizeof(uint32_t));
+        Ckt.fanout = (uint32_t *) cmalloc(Nedges * sizeof(uint32_t));
+        Ckt.type = (unsigned char *) cmalloc(Nnodes);
+    }
+    Pinput = (NSTRUC **) cmalloc(Npi * sizeof(NSTRUC *));
+    Poutput = (NSTRUC **) cmalloc(Npo * sizeof(NSTRUC *));
+    Pvalue = (uint64_t *) cmalloc(Nnodes * sizeof(uint64_t));
     for(i = 0; i<Nnodes; i++) {
         Node[i].indx = i;
         Node[i].fin = Node[i].fout = 0;
+        Node[i].level = -1;
+        Node[i].value = 0;
+        Pvalue[i] = 0;
+    }
+}
+
+
+/*-----------------------------------------------------------------------
+input: scan pointer, end of the line, integer to fill, extra delimiters
+output: 1 if an integer was scanned, 0 otherwise
+called by: cread, vecreader
+description:
+    Hand-written integer scanner for the memory mapped circuit file and
+    the vector files. It skips blanks, reads an optionally signed decimal
+    integer that must end at a blank, the end of the line or one of the
+    stop characters, and leaves the scan pointer right after it.
+-----------------------------------------------------------------------*/
+static int scanint(const char *&p, const char *end, int &v, const char *stop = ""){
+    int neg = 0;
+    long long n = 0;
+
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    if(p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    if(p >= end || *p < '0' || *p > '9') return 0;
+    while(p < end && *p >= '0' && *p <= '9') {
+        n = n * 10 + (*p++ - '0');
+        if(n > 0x7fffffff) return 0;
+    }
+    if(p < end && *p != ' ' && *p != '\t' && *p != '\r' && !(*p && strchr(stop, *p))) return 0;
+    v = neg ? (int)-n : (int)n;
+    return 1;
+}
+
+/* scans a vector value: an integer as scanint() does, or X for VALX */
+static int scanvalue(const char *&p, const char *end, int &v){
+    const char *q = p;
+
+    while(q < end && (*q == ' ' || *q == '\t')) q++;
+    if(q < end && (*q == 'X' || *q == 'x') &&
+       (q + 1 == end || q[1] == ' ' || q[1] == '\t' || q[1] == '\r')) {
+        p = q + 1;
+        v = VALX;
+        return 1;
     }
+    return scanint(p, end, v, "");
 }
 
+/*-----------------------------------------------------------------------
+Compact id map used by cread to resolve node numbers to node indices.
+It is an open addressing hash table sized by the number of nodes, so
+sparse node numbers do not blow up the table the way a direct table
+indexed by the largest node number does.
+-----------------------------------------------------------------------*/
+struct idmap {
+    vector<int> key, val;
+    unsigned mask = 0;
+
+    void init(int n){
+        unsigned size = 16;
+        while(size < 2u * (unsigned)n) size <<= 1;
+        key.assign(size, -1);
+        val.assign(size, -1);
+        mask = size - 1;
+    }
+    unsigned slot(int k) const{
+        unsigned h = (unsigned)k * 2654435761u & mask;
+        while(key[h] != -1 && key[h] != k) h = (h + 1) & mask;
+        return h;
+    }
+    int insert(int k, int v){          /* returns 0 if k is already present */
+        unsigned h = slot(k);
+        if(key[h] == k) return 0;
+        key[h] = k;
+        val[h] = v;
+        return 1;
+    }
+    int find(int k) const{
+        return val[slot(k)];
+    }
+};
 
 /*-----------------------------------------------------------------------
 input: circuit description file name
@@ -261,91 +549,207 @@ output: nothing
 called by: main
 description:
     This routine reads in the circuit description file and set up all the
-    required data structure. It first checks if the file exists, then it
-    sets up a mapping table, determines the number of nodes, PI's and PO's,
-    allocates dynamic data arrays, and fills in the structural information
-    of the circuit. In the ISCAS circuit description format, only upstream
-    nodes are specified. Downstream nodes are implied. However, to facilitate
-    forward implication, they are also built up in the data structure.
-    To have the maximal flexibility, three passes through the circuit file
-    are required: the first pass to determine the size of the mapping table
-    , the second to fill in the mapping table, and the third to actually
-    set up the circuit information. These procedures may be simplified in
-    the future.
+    required data structure. In the ISCAS circuit description format, only
+    upstream nodes are specified. Downstream nodes are implied. However, to
+    facilitate forward implication, they are also built up in the data
+    structure.
+    The file is memory mapped and scanned once with scanint(), one node per
+    line, into a flat list of records. Node numbers are then mapped to node
+    indices through an idmap, which resolves forward references without a
+    second pass over the text. A malformed line is reported with its line
+    number and the READ is abandoned, leaving the previous circuit intact.
+    The topology is stored once in the CSR arrays of Ckt; Node.unodes and
+    Node.dnodes point into pools laid out the same way. Node.fout is the
+    number of fanouts actually used, which may be less than declared.
+    The built topology is saved to a binary cache next to the file and
+    mapped instead of parsing the text while the file is unchanged (see
+    loadcache()). The previous circuit is parked in the registry rather
+    than cleared, and a READ of a parked, unchanged file just makes it
+    current again (see usecircuit()).
 -----------------------------------------------------------------------*/
 std::string inp_name = "";
 void cread(){
-    char buf[MAXLINE];
-    int ntbl, *tbl, i, j, k, nd, tp, fo, fi, ni = 0, no = 0;
-    FILE *fd;
-    NSTRUC *np;
+    phasetimer timer(PH_READ);
+    int i, j, k, nd, tp, gt, fo, fi, nline = 0, nrec, fd, bad = 0;
+    struct stat st;
+    const char *data, *p, *eol, *end;
+
     cp[strlen(cp)-1] = '\0';
-    if((fd = fopen(cp,"r")) == NULL){
+    if((fd = open(cp, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
         printf("File does not exist!\n");
+        if(fd >= 0) close(fd);
         return;
     }
-    inp_name = cp;
-    inputFilename=cp;
-    if(Gstate >= CKTLD) clear();
-    Nnodes = Npi = Npo = ntbl = 0;
-    while(fgets(buf, MAXLINE, fd) != NULL) {
-        if(sscanf(buf,"%d %d", &tp, &nd) == 2) {
-            if(ntbl < nd) ntbl = nd;
-            Nnodes ++;
-            if(tp == PI) Npi++;
-            else if(tp == PO) Npo++;
-        }
-    }
-    tbl = (int *) malloc(++ntbl * sizeof(int));
-    
-    fseek(fd, 0L, 0);
-    i = 0;
-    while(fgets(buf, MAXLINE, fd) != NULL) {
-        if(sscanf(buf,"%d %d", &tp, &nd) == 2) tbl[nd] = i++;
+    if(st.st_size == 0){
+        printf("Error: %s is empty\n", cp);
+        close(fd);
+        return;
     }
-    allocate();
+    if(usecircuit(cp, st) == 0 || loadcache(cp, st) == 0){
+        close(fd);
+        inp_name = cp;
+        inputFilename = cp;
+        admitcircuit(cp, st);
+        Gstate = CKTLD;
+        VERB(1) printf("==> OK");
+        return;
+    }
+    data = (const char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+        printf("Error: cannot map %s\n", cp);
+        return;
+    }
+    madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+    end = data + st.st_size;
+    Stats.bytes += st.st_size;
 
-    fseek(fd, 0L, 0);
-    while(fscanf(fd, "%d %d", &tp, &nd) != EOF) {
-        np = &Node[tbl[nd]];
-        np->num = nd;
-        
-        if(tp == PI) Pinput[ni++] = np;
-        else if(tp == PO) Poutput[no++] = np;
-        
+    /* one record per node: ntype, num, gate type, fout, fin, line, first fanin */
+    vector<int> rtp, rnum, rtype, rfout, rfin, rline, roff, rfanin;
+    for(p = data; p < end && !bad; p = eol + 1) {
+        nline++;
+        eol = (const char *) memchr(p, '\n', end - p);
+        if(eol == NULL) eol = end;
+        if(!scanint(p, eol, tp)) {
+            while(p < eol && isspace(*p)) p++;
+            bad = (p != eol);               /* anything but a blank line */
+            continue;
+        }
+        bad = !scanint(p, eol, nd);
         switch(tp) {
             case PI:
             case PO:
             case GATE:
-                fscanf(fd, "%d %d %d", &np->type, &np->fout, &np->fin);
+                bad = bad || !scanint(p, eol, gt) || !scanint(p, eol, fo) || !scanint(p, eol, fi);
                 break;
             case FB:
-                np->fout = np->fin = 1;
-                fscanf(fd, "%d", &np->type);
+                fo = fi = 1;
+                bad = bad || !scanint(p, eol, gt);
                 break;
             default:
-                printf("Unknown node type!\n");
-                exit(-1);
+                printf("Error: line %d: unknown node type %d\n", nline, tp);
+                munmap((void *) data, st.st_size);
+                return;
+        }
+        if(bad || nd < 0 || gt < IPT || gt > BUFFER || fo < 0 || fi < 0) {
+            bad = 1;
+            break;
         }
-        np->unodes = (NSTRUC **) malloc(np->fin * sizeof(NSTRUC *));
-        np->dnodes = (NSTRUC **) malloc(np->fout * sizeof(NSTRUC *));
-        for(i = 0; i < np->fin; i++) {
-            fscanf(fd, "%d", &nd);
-            np->unodes[i] = &Node[tbl[nd]];
+        rtp.push_back(tp);
+        rnum.push_back(nd);
+        rtype.push_back(gt);
+        rfout.push_back(fo);
+        rfin.push_back(fi);
+        rline.push_back(nline);
+        roff.push_back(rfanin.size());
+        for(i = 0; i < fi && !bad; i++) {
+            bad = !scanint(p, eol, k) || k < 0;     /* node numbers are unsigned, -1 is the idmap sentinel */
+            rfanin.push_back(k);
         }
-        for(i = 0; i < np->fout; np->dnodes[i++] = NULL);
+        while(p < eol && isspace(*p)) p++;
+        bad = bad || (p != eol);
     }
-    for(i = 0; i < Nnodes; i++) {
-        for(j = 0; j < Node[i].fin; j++) {
-            np = Node[i].unodes[j];
-            k = 0;
-            while(np->dnodes[k] != NULL) k++;
-            np->dnodes[k] = &Node[i];
+    munmap((void *) data, st.st_size);
+    if(bad) {
+        printf("Error: line %d: malformed node description\n", nline);
+        return;
+    }
+
+    nrec = rnum.size();
+    idmap ids;
+    ids.init(nrec);
+    for(i = 0; i < nrec; i++) {
+        if(!ids.insert(rnum[i], i)) {
+            printf("Error: line %d: node %d is defined twice\n", rline[i], rnum[i]);
+            return;
+        }
+    }
+    vector<int> used(nrec, 0);
+    for(i = 0; i < nrec; i++) {
+        for(j = 0; j < rfin[i]; j++) {
+            nd = rfanin[roff[i] + j];
+            k = rfanin[roff[i] + j] = ids.find(nd);
+            if(k < 0) {
+                printf("Error: line %d: node %d is not defined\n", rline[i], nd);
+                return;
+            }
+            if(++used[k] > rfout[k]) {
+                printf("Error: line %d: node %d has more than %d fanouts\n", rline[i], rnum[k], rfout[k]);
+                return;
+            }
+        }
+    }
+
+    inp_name = cp;
+    inputFilename=cp;
+    parkcircuit();
+    Nnodes = nrec;
+    Nedges = rfanin.size();
+    Npi = Npo = 0;
+    for(i = 0; i < nrec; i++) {
+        if(rtp[i] == PI) Npi++;
+        else if(rtp[i] == PO) Npo++;
+    }
+    allocate();
+
+    /* CSR fanin is the record fanin list; fanout is filled by counting */
+    for(i = 0; i < nrec; i++) {
+        Ckt.finoff[i + 1] = Ckt.finoff[i] + rfin[i];
+        Ckt.foutoff[i + 1] = Ckt.foutoff[i] + used[i];
+        Ckt.type[i] = rtype[i];
+    }
+    vector<uint32_t> fill(Ckt.foutoff, Ckt.foutoff + nrec);
+    for(i = 0; i < nrec; i++) {
+        for(j = roff[i]; j < roff[i] + rfin[i]; j++) {
+            Ckt.fanin[j] = rfanin[j];
+            Ckt.fanout[fill[rfanin[j]]++] = i;
         }
     }
-    fclose(fd);
+    for(i = 0; i < nrec; i++) {
+        Node[i].num = rnum[i];
+        Node[i].ntype = (enum e_ntype) rtp[i];
+    }
+    linknodes();
+    savecache(cp, st, 0);
+    admitcircuit(cp, st);
     Gstate = CKTLD;
-    printf("==> OK");
+    VERB(1) printf("==> OK");
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: cread, loadcache
+description:
+    Completes Node from the CSR arrays once num and ntype are set: the
+    gate type, fanin and fanout counts, the unodes/dnodes pools, Pinput
+    and Poutput in index order, and the PI number -> Pinput slot table
+    Pislot used by every vector reader.
+-----------------------------------------------------------------------*/
+void linknodes(){
+    int i, ni = 0, no = 0;
+    NSTRUC *np;
+
+    for(i = 0; i < Nedges; i++) {
+        Upool[i] = &Node[Ckt.fanin[i]];
+        Dpool[i] = &Node[Ckt.fanout[i]];
+    }
+    for(i = 0; i < Nnodes; i++) {
+        np = &Node[i];
+        np->type = (enum e_gtype) Ckt.type[i];
+        np->fin = Ckt.finoff[i + 1] - Ckt.finoff[i];
+        np->fout = Ckt.foutoff[i + 1] - Ckt.foutoff[i];
+        np->unodes = Upool + Ckt.finoff[i];
+        np->dnodes = Dpool + Ckt.foutoff[i];
+        if(np->ntype == PI) Pinput[ni++] = np;
+        else if(np->ntype == PO) Poutput[no++] = np;
+    }
+
+    for(i = 0; i < Npi; i++)
+        if((int)Pinput[i]->num >= Npislot) Npislot = Pinput[i]->num + 1;
+    Pislot = (int *) cmalloc(Npislot * sizeof(int));
+    for(i = 0; i < Npislot; i++) Pislot[i] = -1;
+    for(i = 0; i < Npi; i++) Pislot[Pinput[i]->num] = i;
 }
 
 /*-----------------------------------------------------------------------
@@ -357,17 +761,18 @@ description:
 -----------------------------------------------------------------------*/
 void pc(){
     int i, j;
-    NSTRUC *np;
+    uint32_t k;
     std::string gname(int);
    
+    ecosync();
     printf(" Node   Type \tIn     \t\t\tOut    \n");
     printf("------ ------\t-------\t\t\t-------\n");
-    for(i = 0; i<Nnodes; i++) {
-        np = &Node[i];
+    for(j = 0; j<Nnodes; j++) {
+        i = FILEIDX(j);
         printf("\t\t\t\t\t");
-        for(j = 0; j<np->fout; j++) printf("%d ",np->dnodes[j]->num);
-        printf("\r%5d  %s\t", np->num, gname(np->type).c_str());
-        for(j = 0; j<np->fin; j++) printf("%d ",np->unodes[j]->num);
+        for(k = Ckt.foutoff[i]; k<Ckt.foutoff[i+1]; k++) printf("%d ",Node[Ckt.fanout[k]].num);
+        printf("\r%5d  %s\t", Node[i].num, gname(Ckt.type[i]).c_str());
+        for(k = Ckt.finoff[i]; k<Ckt.finoff[i+1]; k++) printf("%d ",Node[Ckt.fanin[k]].num);
         printf("\n");
     }
     printf("Primary inputs:  ");
@@ -381,35 +786,93 @@ void pc(){
     printf("Number of primary outputs = %d\n", Npo);
 }
 /*=====================================Levelizer====================================*/
-void lev() {
-   for(int i=0;i<Nnodes;i++){
-        Node[i].level=-1; 
-   }
-   for(int i=0;i<Npi;i++){
-        Pinput[i]->level=0;
-   }
-    int node_flag=1;//1 means we check all ndoes for one iteration.
-    while(node_flag){
-        node_flag=0;// we are gonna check, let flag 0
-
-        for(int i=0;i<Nnodes;i++){
-            if(Node[i].level==-1){
-                int all_up_nodes=1;// the flag means that we assume up nodes finish its level are gonna 
-                int level=-1;//the value after checking up nodes and update level
-                for(int j=0;j<Node[i].fin;j++){//check up nodes
-                    if(Node[i].unodes[j]->level==-1){// it means not all up nodes are evaluated 
-                        all_up_nodes=0;
-                        break;
-                    }
-                    level=max(level,Node[i].unodes[j]->level);
-                }    
-                if(all_up_nodes){ //we finish checking all up nodes  
-                    Node[i].level=level+1;
-                    node_flag=1;
-                }
-            }
+/* buckets the nodes by Node.level into Levstart/Levnode (counting sort,
+   stable in node index order) */
+static void levbucket(){
+    int i;
+
+    for(i = 0; i < Nnodes; i++)
+        if(Node[i].level + 1 > Nlevels) Nlevels = Node[i].level + 1;
+    Levstart = (int *) ccalloc(Nlevels + 1, sizeof(int));
+    Levnode = (int *) cmalloc(Nnodes * sizeof(int));
+    for(i = 0; i < Nnodes; i++) Levstart[Node[i].level + 1]++;
+    for(i = 0; i < Nlevels; i++) Levstart[i + 1] += Levstart[i];
+    vector<int> fill(Levstart, Levstart + Nlevels);
+    for(i = 0; i < Nnodes; i++) Levnode[fill[Node[i].level]++] = i;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: 0 on success, -1 if the circuit has a combinational loop
+called by: lev, logicsim
+description:
+    Kahn-style topological levelizer on the CSR topology. Every node waits
+    for its fanin up nodes; a node is emitted as soon as the last of them is done, and its
+    level is one more than the largest up node level. Each edge is
+    visited once, so this is linear in the circuit size. The nodes are
+    then bucketed by level into Levnode, with level l occupying
+    Levnode[Levstart[l]] .. Levnode[Levstart[l+1]-1] in index order, which
+    the simulators walk instead of rescanning Node for every level.
+    Nodes that are never emitted sit on (or behind) a loop; they are
+    reported and keep level -1.
+-----------------------------------------------------------------------*/
+int levelize(){
+    int i, head = 0, tail = 0;
+    uint32_t k, n, d;
+
+    ecosync();
+    free(Levnode);
+    free(Levstart);
+    Levnode = Levstart = NULL;
+    Nlevels = 0;
+    free(Tape);                     /* the tape follows the levels */
+    free(Tapefin);
+    free(Tapelev);
+    free(Phasestart);
+    free(Phasepar);
+    Tape = NULL;
+    Tapefin = NULL;
+    Tapelev = NULL;
+    Phasestart = NULL;
+    Phasepar = NULL;
+
+    vector<unsigned> pending(Nnodes);
+    vector<int> queue(Nnodes);
+    for(i = 0; i < Nnodes; i++) {
+        Node[i].level = -1;
+        pending[i] = Ckt.finoff[i + 1] - Ckt.finoff[i];
+        if(pending[i] == 0) {
+            Node[i].level = 0;
+            queue[tail++] = i;
+        }
+    }
+    while(head < tail) {
+        n = queue[head++];
+        for(k = Ckt.foutoff[n]; k < Ckt.foutoff[n + 1]; k++) {
+            d = Ckt.fanout[k];
+            if(Node[d].level < Node[n].level + 1) Node[d].level = Node[n].level + 1;
+            if(--pending[d] == 0) queue[tail++] = d;
+        }
+    }
+    if(tail < Nnodes) {
+        printf("Error: combinational loop detected, %d nodes cannot be levelized:\n", Nnodes - tail);
+        for(i = 0; i < Nnodes; i++) {
+            if(pending[i] == 0) continue;
+            Node[i].level = -1;
+            printf("%d ", Node[i].num);
         }
+        printf("\n");
+        return -1;
     }
+
+    levbucket();
+    return 0;
+}
+
+void lev() {
+    phasetimer timer(PH_LEV);
+    if(levelize() < 0 || compile() < 0) return;
+    cachelevels();
     /*------------------------Naming---------------------------------*/
     // Name Circuit in the file
     string cir_name;
@@ -434,213 +897,4897 @@ void lev() {
    out<<"#Gates: "<<num_gates<<endl;
 
     for (int i = 0; i < Nnodes; i++) {
-        out<<Node[i].num<<" "<<Node[i].level<<endl;
+        out<<Node[FILEIDX(i)].num<<" "<<Node[FILEIDX(i)].level<<endl;
     }
 
     out.close();
      for (int i = 0; i < Nnodes; i++) {
-        cout << "Node " << Node[i].num << " is at level " << Node[i].level << endl;
+        VERB(2) cout << "Node " << Node[i].num << " is at level " << Node[i].level << endl;
     }
 
  
 }
 
-/*===========================Logic Simulator*===========================*/
-//Those void functions below are used in logicsim()
-bool sort_input(const NSTRUC* a, NSTRUC* b){
-    return a->num < b->num;
-}
-//Read the input File
-void readfile(){
-    cout<<endl<<"******Start read the input file**********"<<endl;
-    ifstream circuitfile(inputFilename.c_str());
-    if(!circuitfile.is_open()){
-        cerr<<"ERROR! We cannot read the input file!!"<<endl;
-        return;
-    }
-    cout << "Name of the input file: " << inputFilename << endl;
-    //Find the max Node ID in the circuit
-    int max_PI_ID=0;
-    string line;
-    while(getline(circuitfile, line)){
-        stringstream se(line);
-        string data;
-        getline(se, data, ',');
-        int PI_ID;
-        stringstream(data) >> PI_ID;
-        if (PI_ID > max_PI_ID) {
-            max_PI_ID = PI_ID;
-        }
-    }
-    while (getline(circuitfile, line)) {
-        cout <<"The content in input file:"<< line << endl;
-    }//for test
-
-    circuitfile.clear(); //clear array 
-    circuitfile.seekg(0);// read the input file in pos 0
-    
-    vector<int> input_content(max_PI_ID+1, -1); 
-    int PI_ID, PI_value,idx=0;
-    while(getline(circuitfile, line)){//Loading the value in inputfile xxx.txt
-        if(idx<Npi){
-            stringstream ss(line);
-            string data;
-            getline(ss,data,',');
-            stringstream(data)>>PI_ID;//Change string to the integer
-            getline(ss,data,',');
-            stringstream(data)>>PI_value;
-            input_content[PI_ID]=PI_value;
-            cout<<"PI_ID "<<PI_ID<<" PI_value "<<input_content[PI_ID]<<endl;
-            idx++;
-        }
-        else{
-            cerr << "Error: More primary inputs than expected!" << endl;
-            break;
-        }
-    }
-    circuitfile.close();
-    //Sort Input based on PI_ID
-    std::sort(Pinput, Pinput+Npi, sort_input);
-    //Arrange the order of PI Nodes
-    for(int i=0;i<Npi;i++){
-        int npi_num=Pinput[i]->num;
-        if(npi_num <= max_PI_ID && input_content[npi_num] != -1){
-            Pinput[i]->value=input_content[npi_num];
-        }
-    }
-    //Check the values we load on terminal
-    for(int j=0;j<Npi;j++){
-        cout<<"PI No."<<j<<", "<<Pinput[j]->value<<endl;
+/*==========================Binary Netlist Cache==========================*/
+/*-----------------------------------------------------------------------
+READ saves the topology it built from a circuit file to <file>.rcb and,
+while the file keeps its size and mtime, maps that cache instead of
+parsing the text. The CSR arrays are used in place from the mapping, so
+a reload costs the page faults of the cache plus one pass to link Node.
+All fields are native-endian; the layout is a cachehdr followed by the
+arrays below, each starting on an 8-byte boundary:
+
+    num      uint32[Nnodes]     node numbers
+    ntype    uint8[Nnodes]      e_ntype
+    type     uint8[Nnodes]      Ckt.type
+    finoff   uint32[Nnodes+1]   Ckt.finoff
+    fanin    uint32[Nedges]     Ckt.fanin
+    foutoff  uint32[Nnodes+1]   Ckt.foutoff
+    fanout   uint32[Nedges]     Ckt.fanout
+    level    int32[Nnodes]      only if nlevels > 0 (written by LEV)
+
+A cache of another version, byte order or source is ignored and
+rewritten.
+-----------------------------------------------------------------------*/
+#define CACHEMAGIC "RCKTBIN"
+#define CACHEVER 1                  /* version of the cache layout */
+#define CACHEORDER 0x01020304u      /* byte order check */
+
+struct cachehdr {
+    char magic[8];
+    uint32_t version, order;
+    uint64_t filesize;              /* size of the cache itself */
+    uint64_t srcsize;               /* size and mtime of the circuit file */
+    int64_t srcmtime, srcmtimens;
+    uint32_t nnodes, nedges, npi, npo;
+    uint32_t nlevels;               /* 0 if no levels are stored */
+    uint32_t pad;
+    uint64_t sum;                   /* cachesum() of the arrays */
+};
+
+static void *Cktmap;            /* mapped cache holding Ckt, NULL if Ckt is allocated */
+static size_t Cktmapsize;
+static string Srcname;          /* circuit file of the last READ */
+static struct stat Srcstat;
+static int Cachelev;            /* the cache of Srcname has levels, or is not wanted */
+static int Nocache;             /* write no caches, set while SERVE reads the files clients name */
+
+/* byte offsets of the arrays in a cache of n nodes and e edges */
+struct cachelayout {
+    size_t num, ntype, type, finoff, fanin, foutoff, fanout, level, end;
+
+    cachelayout(size_t n, size_t e, int levels){
+        size_t o = sizeof(cachehdr);
+        num = o;      o = (o + 4 * n + 7) & ~(size_t) 7;
+        ntype = o;    o = (o + n + 7) & ~(size_t) 7;
+        type = o;     o = (o + n + 7) & ~(size_t) 7;
+        finoff = o;   o = (o + 4 * (n + 1) + 7) & ~(size_t) 7;
+        fanin = o;    o = (o + 4 * e + 7) & ~(size_t) 7;
+        foutoff = o;  o = (o + 4 * (n + 1) + 7) & ~(size_t) 7;
+        fanout = o;   o = (o + 4 * e + 7) & ~(size_t) 7;
+        level = o;    if(levels) o = (o + 4 * n + 7) & ~(size_t) 7;
+        end = o;
     }
-    cout<<"************Finish Read values to PI in readfile()***********"<<endl<<endl;
-    
+};
+
+static string cachename(const char *name){
+    return string(name) + ".rcb";
 }
 
-bool gatefunction(enum e_gtype type, vector<bool>inputvalue){//IPT, BRCH XOR, OR, NOR, NOT, NAND, AND,XNOR, BUFFER
-    bool result;
-    switch(type){
-        cout<<"*******New section to analyze gates in gatefunction()******"<<endl;
-        case BRCH:
-            result=inputvalue[0];
-            break;
-        case OR:
-            result=0;//noncontrolling value
-            for(size_t i=0;i<inputvalue.size();i++){
-                result|=inputvalue[i];
-            }
-            break;
-        case XOR:
-            result=0;
-            for(size_t i=0;i<inputvalue.size();i++){
-                result^=inputvalue[i];
-            }   
-            break; 
-        case NOR:
-            result=0;
-            for(size_t i=0;i<inputvalue.size();i++){
-                result|=inputvalue[i];
-            }   
-            result=!result;
-            break; 
-         case NOT:
-            result=!inputvalue[0]; 
-            break;
-        case NAND:
-            result=1;
-            for(size_t i=0;i<inputvalue.size();i++){
-                result&=inputvalue[i];
-            }
-            result=!result;    
-            break;
-        case AND:
-            result=1;
-            for(size_t i=0;i<inputvalue.size();i++){
-                result&=inputvalue[i];
-            }    
-            break;
-        case XNOR:
-            result=0;
-            for(size_t i=0;i<inputvalue.size();i++){
-                result^=inputvalue[i];
-            }    
-            result=!result; 
-            break;
-        case BUFFER:
-            result = inputvalue[0];
-            break;
-        
-        default:
-        cerr<<"Error in Logic Gate Calculation"<<endl<<endl;;
-        break;
+/* checksum of the 8-byte words of a cache after the header */
+static uint64_t cachesum(const char *base, size_t size){
+    uint64_t h = 0xcbf29ce484222325ULL, w;
+    size_t o;
+
+    for(o = sizeof(cachehdr); o + 8 <= size; o += 8) {
+        memcpy(&w, base + o, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
     }
-    return result;
+    return h;
 }
-void circuit_value_calculation(){
-    cout<<"*****Start gate calculation in circuit_value_calculation()*****"<<endl;
-    //Find the max level in the circuit because we want level-by-level driven simulator
-    int max_level=0;
-    for(int i=0;i<Nnodes;i++){
-        if(Node[i].level>max_level){
-            max_level=Node[i].level;
-        }
-    }
-    for(int currentLevel=0;currentLevel<=max_level;currentLevel++){
-        cout << "Processing gates at level: " << currentLevel<<endl;
-        for(int i=0;i<Nnodes;i++){
-            if(Node[i].level!=currentLevel)continue;
-            if (Node[i].type == IPT) {
-                cout << "Skipping primary input node: " << Node[i].num << endl;
-                continue;
-            }
-            vector<bool>inputvalue;
-            if(Node[i].type==BRCH||Node[i].type==XOR||Node[i].type==OR||Node[i].type==NOR
-            ||Node[i].type==NOT||Node[i].type==NAND||Node[i].type==AND||Node[i].type==XNOR||
-            Node[i].type==BUFFER){
-                inputvalue.clear(); 
-                for(int j=0;j<Node[i].fin;j++){
-                    if(Node[i].unodes[j]!=NULL ){
-                        inputvalue.push_back(Node[i].unodes[j]->value);//store all unodes value to value array
-                    }
-                    else {
-                         cerr << "Error: unodes[" << j << "] for Node[" << i << "] is NULL!" << endl;
-                    }
-                }
-                if(!inputvalue.empty())  {  
-                    bool result=gatefunction(Node[i].type, inputvalue); 
-                    Node[i].value=result; 
-                    cout<< "This "<<gname(Node[i].type)<<" output is "<<Node[i].value<<endl;  
-                }
-            }
-        }
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: clear, permute
+description:
+    Releases the CSR arrays of Ckt, unmapping them if they live in a
+    mapped cache.
+-----------------------------------------------------------------------*/
+void freeckt(){
+    if(Cktmap) munmap(Cktmap, Cktmapsize);
+    else {
+        free(Ckt.finoff);
+        free(Ckt.fanin);
+        free(Ckt.foutoff);
+        free(Ckt.fanout);
+        free(Ckt.type);
     }
-    cout<<"*****Finish gate calculation in circuit_value_calculation() and gatefunction()*****"<<endl<<endl;
+    Cktmap = NULL;
+    Cktmapsize = 0;
+    memset(&Ckt, 0, sizeof(Ckt));
 }
-void outfilewriting(){
-    cout<<"*****Start Writing the output file****"<<endl;
-    ofstream outfile(outputFilename.c_str());
-    cout<<"Output File Name is "<<outputFilename<<endl;
-    if(!outfile){
-        cerr<<"Cannot open a output file to write"<<endl;
-        return;
+
+/*-----------------------------------------------------------------------
+input: circuit file name, its stat
+output: 0 if the circuit was loaded from the cache, -1 otherwise
+called by: cread
+description:
+    Maps <name>.rcb and, if it is a valid cache of this version for a
+    file of the same size and mtime, replaces the current circuit with
+    it. The cache carries a checksum and every offset, node index, gate
+    type and stored level (below the levels of the down nodes) is
+    checked as well, so a damaged cache falls back to parsing the text
+    instead of crashing. The previous circuit is kept on failure.
+-----------------------------------------------------------------------*/
+int loadcache(const char *name, const struct stat &src){
+    int fd, i;
+    struct stat st;
+    const cachehdr *h;
+    char *base;
+    uint32_t k;
+    string cname = cachename(name);
+
+    if((fd = open(cname.c_str(), O_RDONLY)) < 0) return -1;
+    if(fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(cachehdr)) {
+        close(fd);
+        return -1;
     }
+    base = (char *) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) return -1;
+    h = (const cachehdr *) base;
+    cachelayout lay(h->nnodes, h->nedges, h->nlevels > 0);
+    const uint32_t *num = (const uint32_t *) (base + lay.num);
+    const unsigned char *ntype = (const unsigned char *) (base + lay.ntype), *type = (const unsigned char *) (base + lay.type);
+    const int32_t *level = (const int32_t *) (base + lay.level);
+    uint32_t *finoff = (uint32_t *) (base + lay.finoff), *foutoff = (uint32_t *) (base + lay.foutoff);
+    uint32_t *fanin = (uint32_t *) (base + lay.fanin), *fanout = (uint32_t *) (base + lay.fanout);
+    uint32_t npi = 0, npo = 0;
+    int ok = memcmp(h->magic, CACHEMAGIC, sizeof(CACHEMAGIC)) == 0 && h->version == CACHEVER &&
+             h->order == CACHEORDER && h->filesize == (uint64_t) st.st_size && lay.end == (size_t) st.st_size &&
+             h->srcsize == (uint64_t) src.st_size && h->srcmtime == (int64_t) src.st_mtim.tv_sec &&
+             h->srcmtimens == (int64_t) src.st_mtim.tv_nsec && h->nnodes > 0 && h->nnodes < 0x7fffffffu &&
+             h->nedges < 0x7fffffffu && h->sum == cachesum(base, st.st_size);
 
-    for(int i=0;i<Npo;i++){
-        outfile<< Poutput[i]->num<<","<<Poutput[i]->value<<endl;
-        cout<< "The gate of Primary Output is "<<gname(Poutput[i]->type)<<",Node number is "<<Poutput[i]->num<<", the gateoutput is "<<Poutput[i]->value<<endl;
+    for(i = 0; ok && i < (int) h->nnodes; i++) {
+        ok = finoff[i] <= finoff[i + 1] && foutoff[i] <= foutoff[i + 1] && ntype[i] <= PO && type[i] <= BUFFER &&
+             (h->nlevels == 0 || (level[i] >= 0 && level[i] < (int32_t) h->nlevels));
+        npi += ntype[i] == PI;
+        npo += ntype[i] == PO;
+    }
+    ok = ok && finoff[0] == 0 && foutoff[0] == 0 && finoff[h->nnodes] == h->nedges && foutoff[h->nnodes] == h->nedges &&
+         npi == h->npi && npo == h->npo;
+    for(k = 0; ok && k < h->nedges; k++) ok = fanin[k] < h->nnodes && fanout[k] < h->nnodes;
+    for(i = 0; ok && h->nlevels && i < (int) h->nnodes; i++)      /* the levels must order every edge */
+        for(k = finoff[i]; ok && k < finoff[i + 1]; k++) ok = level[fanin[k]] < level[i];
+    if(!ok) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    parkcircuit();
+    Nnodes = h->nnodes;
+    Nedges = h->nedges;
+    Npi = h->npi;
+    Npo = h->npo;
+    allocate(0);
+    Cktmap = base;
+    Cktmapsize = st.st_size;
+    Ckt.finoff = finoff;
+    Ckt.fanin = fanin;
+    Ckt.foutoff = foutoff;
+    Ckt.fanout = fanout;
+    Ckt.type = (unsigned char *) type;
+    for(i = 0; i < Nnodes; i++) {
+        Node[i].num = num[i];
+        Node[i].ntype = (enum e_ntype) ntype[i];
+    }
+    linknodes();
+    if(h->nlevels) {
+        for(i = 0; i < Nnodes; i++) Node[i].level = level[i];
+        levbucket();
+    }
+    Srcname = name;
+    Srcstat = src;
+    Cachelev = h->nlevels > 0;
+    Stats.bytes += st.st_size;
+    VERB(2) printf("%s mapped, %d nodes, %d edges%s\n", cname.c_str(), Nnodes, Nedges, Nlevels ? ", levelized" : "");
+    return 0;
+}
+
+/*-----------------------------------------------------------------------
+input: circuit file name, its stat at READ, save the levels
+output: 0 on success, -1 if the cache cannot be written
+called by: cread, cachelevels
+description:
+    Writes the cache of the current circuit, which must be in file order,
+    under a temporary name and renames it into place, so a concurrent
+    READ never maps a partial cache. A read-only directory just means no
+    cache, and so does SERVE (see Nocache).
+-----------------------------------------------------------------------*/
+int savecache(const char *name, const struct stat &src, int levels){
+    cachehdr h;
+    vecwriter out;
+    string cname = cachename(name);
+    char tmp[MAXNAME + 32];
+    vector<uint32_t> u32(Nnodes);
+    vector<unsigned char> u8(Nnodes);
+    static const char zero[8] = {0};
+    int i;
+
+    Srcname = name;
+    Srcstat = src;
+    Cachelev = Nocache;
+    if(Nocache) return -1;
+    levels = levels && Nlevels > 0;
+    cachelayout lay(Nnodes, Nedges, levels);
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHEMAGIC, sizeof(CACHEMAGIC));
+    h.version = CACHEVER;
+    h.order = CACHEORDER;
+    h.filesize = lay.end;
+    h.srcsize = src.st_size;
+    h.srcmtime = src.st_mtim.tv_sec;
+    h.srcmtimens = src.st_mtim.tv_nsec;
+    h.nnodes = Nnodes;
+    h.nedges = Nedges;
+    h.npi = Npi;
+    h.npo = Npo;
+    h.nlevels = levels ? Nlevels : 0;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", cname.c_str(), (int) getpid());
+    if(out.open(tmp) < 0) {
+        VERB(2) printf("cannot write %s, no binary cache\n", cname.c_str());
+        return -1;
+    }
+    out.write((const char *) &h, sizeof(h));
+    for(i = 0; i < Nnodes; i++) u32[i] = Node[i].num;
+    out.write((const char *) &u32[0], 4 * Nnodes);
+    out.write(zero, lay.ntype - lay.num - 4 * Nnodes);
+    for(i = 0; i < Nnodes; i++) u8[i] = Node[i].ntype;
+    out.write((const char *) &u8[0], Nnodes);
+    out.write(zero, lay.type - lay.ntype - Nnodes);
+    out.write((const char *) Ckt.type, Nnodes);
+    out.write(zero, lay.finoff - lay.type - Nnodes);
+    out.write((const char *) Ckt.finoff, 4 * (Nnodes + 1));
+    out.write(zero, lay.fanin - lay.finoff - 4 * (Nnodes + 1));
+    out.write((const char *) Ckt.fanin, 4 * Nedges);
+    out.write(zero, lay.foutoff - lay.fanin - 4 * Nedges);
+    out.write((const char *) Ckt.foutoff, 4 * (Nnodes + 1));
+    out.write(zero, lay.fanout - lay.foutoff - 4 * (Nnodes + 1));
+    out.write((const char *) Ckt.fanout, 4 * Nedges);
+    out.write(zero, lay.level - lay.fanout - 4 * Nedges);
+    if(levels) {
+        for(i = 0; i < Nnodes; i++) u32[i] = Node[i].level;
+        out.write((const char *) &u32[0], 4 * Nnodes);
+        out.write(zero, lay.end - lay.level - 4 * Nnodes);
+    }
+    if(out.close() < 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    /* fill in the checksum from the file as written */
+    int fd = open(tmp, O_RDWR);
+    char *base = fd < 0 ? (char *) MAP_FAILED : (char *) mmap(NULL, lay.end, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(fd >= 0) close(fd);
+    if(base == MAP_FAILED) {
+        unlink(tmp);
+        return -1;
+    }
+    ((cachehdr *) base)->sum = cachesum(base, lay.end);
+    munmap(base, lay.end);
+    if(rename(tmp, cname.c_str()) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    Cachelev = levels;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: lev
+description:
+    Adds the levels to the cache of the circuit after LEV, so the next
+    READ of it is levelized already. Skipped once the nodes have been
+    renumbered (see REORDER) or the file has changed since READ.
+-----------------------------------------------------------------------*/
+void cachelevels(){
+    struct stat st;
+
+    if(Cachelev || Nocache || Fileorder || Srcname.empty() || stat(Srcname.c_str(), &st) < 0 ||
+       st.st_size != Srcstat.st_size || st.st_mtim.tv_sec != Srcstat.st_mtim.tv_sec ||
+       st.st_mtim.tv_nsec != Srcstat.st_mtim.tv_nsec) return;
+    savecache(Srcname.c_str(), Srcstat, 1);
+    Cachelev = 1;
+}
+
+/*=============================Circuit Compiler============================*/
+/*-----------------------------------------------------------------------
+input: nothing
+output: 0 on success, -1 if the circuit cannot be levelized
+called by: lev, logicsim
+description:
+    Lowers the levelized circuit into the simulation tape: one TSTRUC op
+    per evaluated gate in level order, with the gates of a level grouped
+    by gate type so the simulation loop sees long runs of the same op.
+    The fanin slots are copied into Tapefin in tape order, so the whole
+    simulation is a sequential sweep over Tape and Tapefin. The tape is
+    kept until the next LEV or READ. The levels are also grouped into
+    the barrier phases of the threaded simulator (see simpool).
+-----------------------------------------------------------------------*/
+int compile(){
+    int i, l, t, n;
+    uint32_t k, nfin = 0;
+
+    free(Tape);
+    free(Tapefin);
+    free(Tapelev);
+    free(Phasestart);
+    free(Phasepar);
+    Tape = NULL;
+    Tapefin = NULL;
+    Tapelev = NULL;
+    Phasestart = NULL;
+    Phasepar = NULL;
+    freecones();
+    freenative();
+    if(Nlevels == 0 && levelize() < 0) return -1;
+
+    Ntape = 0;
+    for(i = 0; i < Nnodes; i++) {
+        if(Ckt.type[i] == IPT || Ckt.finoff[i + 1] == Ckt.finoff[i]) continue;
+        Ntape++;
+        nfin += Ckt.finoff[i + 1] - Ckt.finoff[i];
+    }
+    Tape = (TSTRUC *) cmalloc(Ntape * sizeof(TSTRUC));
+    Tapefin = (uint32_t *) cmalloc(nfin * sizeof(uint32_t));
+    Tapelev = (int *) cmalloc((Nlevels + 1) * sizeof(int));
+
+    Ntape = 0;
+    nfin = 0;
+    for(l = 0; l < Nlevels; l++) {
+        Tapelev[l] = Ntape;
+        for(t = BRCH; t <= BUFFER; t++) {
+            for(i = Levstart[l]; i < Levstart[l + 1]; i++) {
+                n = Levnode[i];
+                if(Ckt.type[n] != t || Ckt.finoff[n + 1] == Ckt.finoff[n]) continue;
+                Tape[Ntape].op = t;
+                Tape[Ntape].out = n;
+                Tape[Ntape].fin = nfin;
+                Tape[Ntape].nfin = Ckt.finoff[n + 1] - Ckt.finoff[n];
+                for(k = Ckt.finoff[n]; k < Ckt.finoff[n + 1]; k++) Tapefin[nfin++] = Ckt.fanin[k];
+                Ntape++;
+            }
+        }
+    }
+    Tapelev[Nlevels] = Ntape;
+
+    /* barrier phases of the threaded simulator: a wide level is split
+       across the threads, consecutive narrow levels are merged into one
+       phase that a single thread runs */
+    Phasestart = (int *) cmalloc((Nlevels + 1) * sizeof(int));
+    Phasepar = (unsigned char *) cmalloc(Nlevels + 1);
+    Nphase = 0;
+    for(l = 0; l < Nlevels; l++) {
+        n = Tapelev[l + 1] - Tapelev[l];
+        if(n == 0) continue;
+        if(n >= PARMIN || Nphase == 0 || Phasepar[Nphase - 1]) {
+            Phasestart[Nphase] = Tapelev[l];
+            Phasepar[Nphase++] = n >= PARMIN;
+        }
+    }
+    Phasestart[Nphase] = Ntape;
+    return 0;
+}
+
+/*============================Node Renumbering============================*/
+/*-----------------------------------------------------------------------
+input: new order of the nodes, order[new index] = old index
+output: nothing
+called by: renumber
+description:
+    Moves every node to its new index: rebuilds Node, the unodes/dnodes
+    pools and the CSR arrays in the new order and remaps Pinput, Poutput,
+    Pvalue and Fileorder. The nodes keep their num, and Pinput/Poutput
+    their order, so vector and result files do not change. The levels
+    and the tape are rebuilt for the new indices.
+-----------------------------------------------------------------------*/
+static void permute(const vector<int> &order){
+    int i, o;
+    uint32_t k, nf = 0, no = 0;
+    vector<int> newof(Nnodes);
+    NSTRUC *node = (NSTRUC *) cmalloc(Nnodes * sizeof(NSTRUC));
+    NSTRUC **upool = (NSTRUC **) cmalloc(Nedges * sizeof(NSTRUC *));
+    NSTRUC **dpool = (NSTRUC **) cmalloc(Nedges * sizeof(NSTRUC *));
+    CSTRUC c;
+    uint64_t *pvalue = (uint64_t *) cmalloc(Nnodes * sizeof(uint64_t));
+    int *fileorder = (int *) cmalloc(Nnodes * sizeof(int));
+
+    for(i = 0; i < Nnodes; i++) newof[order[i]] = i;
+    c.finoff = (uint32_t *) cmalloc((Nnodes + 1) * sizeof(uint32_t));
+    c.fanin = (uint32_t *) cmalloc(Nedges * sizeof(uint32_t));
+    c.foutoff = (uint32_t *) cmalloc((Nnodes + 1) * sizeof(uint32_t));
+    c.fanout = (uint32_t *) cmalloc(Nedges * sizeof(uint32_t));
+    c.type = (unsigned char *) cmalloc(Nnodes);
+    for(i = 0; i < Nnodes; i++) {
+        o = order[i];
+        node[i] = Node[o];
+        node[i].indx = i;
+        node[i].unodes = upool + nf;
+        node[i].dnodes = dpool + no;
+        c.finoff[i] = nf;
+        c.foutoff[i] = no;
+        c.type[i] = Ckt.type[o];
+        for(k = Ckt.finoff[o]; k < Ckt.finoff[o + 1]; k++, nf++) {
+            c.fanin[nf] = newof[Ckt.fanin[k]];
+            upool[nf] = node + c.fanin[nf];
+        }
+        for(k = Ckt.foutoff[o]; k < Ckt.foutoff[o + 1]; k++, no++) {
+            c.fanout[no] = newof[Ckt.fanout[k]];
+            dpool[no] = node + c.fanout[no];
+        }
+        pvalue[i] = Pvalue[o];
+    }
+    c.finoff[Nnodes] = nf;
+    c.foutoff[Nnodes] = no;
+    for(i = 0; i < Npi; i++) Pinput[i] = node + newof[Pinput[i] - Node];
+    for(i = 0; i < Npo; i++) Poutput[i] = node + newof[Poutput[i] - Node];
+    for(i = 0; i < Nnodes; i++) fileorder[i] = newof[Fileorder ? Fileorder[i] : i];
+
+    free(Node);
+    free(Upool);
+    free(Dpool);
+    freeckt();
+    free(Pvalue);
+    free(Fileorder);
+    Node = node;
+    Upool = upool;
+    Dpool = dpool;
+    Ckt = c;
+    Pvalue = pvalue;
+    Fileorder = fileorder;
+}
+
+/* mean distance in the Node array between a gate and its fanins */
+static double fanindistance(){
+    long long d = 0;
+    uint32_t k;
+    int i;
+
+    for(i = 0; i < Nnodes; i++)
+        for(k = Ckt.finoff[i]; k < Ckt.finoff[i + 1]; k++)
+            d += llabs((long long) i - Ckt.fanin[k]);
+    return Nedges ? (double) d / Nedges : 0.0;
+}
+
+/*-----------------------------------------------------------------------
+input: ordering, ORD_LEVEL or ORD_DFS
+output: 0 on success, -1 if the circuit cannot be levelized
+called by: reorder, bench
+description:
+    Renumbers the nodes so that a gate sits close to its fanins and the
+    simulators walk the value array mostly forward:
+
+    ORD_LEVEL  level-major; within a level the nodes are sorted by their
+               lowest renumbered fanin, ties in index order (so PIs keep
+               file order): the Cuthill-McKee rule applied level by level
+    ORD_DFS    depth-first from the POs, a node after all its fanins,
+               so every output cone is a contiguous run; nodes that feed
+               no PO follow in file order
+
+    The tape is recompiled for the new indices.
+-----------------------------------------------------------------------*/
+int renumber(int how){
+    int i, l, n, top;
+    uint32_t k;
+    vector<int> order, key;
+    vector< pair<int, int> > byfanin;
+
+    if(Nlevels == 0 && levelize() < 0) return -1;
+    order.reserve(Nnodes);
+    if(how == ORD_LEVEL) {
+        vector<int> newof(Nnodes, -1);
+        for(l = 0; l < Nlevels; l++) {
+            byfanin.clear();
+            for(i = Levstart[l]; i < Levstart[l + 1]; i++) {
+                n = Levnode[i];
+                top = Nnodes;
+                for(k = Ckt.finoff[n]; k < Ckt.finoff[n + 1]; k++) top = min(top, newof[Ckt.fanin[k]]);
+                byfanin.push_back(make_pair(top, n));
+            }
+            sort(byfanin.begin(), byfanin.end());
+            for(size_t j = 0; j < byfanin.size(); j++) {
+                newof[byfanin[j].second] = order.size();
+                order.push_back(byfanin[j].second);
+            }
+        }
+    }
+    else {
+        /* iterative post-order; key holds the next fanin to visit, -1 once emitted */
+        vector<int> stack;
+        key.assign(Nnodes, 0);
+        for(top = 0; top < Npo + Nnodes; top++) {
+            n = top < Npo ? Poutput[top]->indx : top - Npo;
+            if(key[n] < 0) continue;
+            stack.push_back(n);
+            while(!stack.empty()) {
+                n = stack.back();
+                if(key[n] < 0) { stack.pop_back(); continue; }
+                if((uint32_t) key[n] < Ckt.finoff[n + 1] - Ckt.finoff[n]) {
+                    int f = Ckt.fanin[Ckt.finoff[n] + key[n]++];
+                    if(key[f] >= 0) stack.push_back(f);
+                    continue;
+                }
+                key[n] = -1;
+                order.push_back(n);
+                stack.pop_back();
+            }
+        }
+    }
+    permute(order);
+    if(levelize() < 0 || compile() < 0) return -1;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    REORDER [level|dfs] renumbers the nodes for memory locality (see
+    renumber()) and reports the mean fanin distance before and after.
+    Node numbers, PI/PO order and every output file stay the same; PC,
+    LEV and the fault lists still list the nodes in file order.
+-----------------------------------------------------------------------*/
+void reorder(){
+    phasetimer timer(PH_LEV);
+    stringstream st(cp);
+    string arg;
+    int how = ORD_LEVEL;
+    double before;
+
+    if(st>>arg) {
+        if(arg == "dfs" || arg == "DFS") how = ORD_DFS;
+        else if(arg != "level" && arg != "LEVEL") {
+            printf("Error: unknown ordering %s\n", arg.c_str());
+            return;
+        }
+    }
+    before = fanindistance();
+    if(renumber(how) < 0) return;
+    printf("==> %s order, mean fanin distance %.1f -> %.1f nodes", how == ORD_DFS ? "dfs" : "level", before, fanindistance());
+}
+
+/*=============================Gate Kernels==============================*/
+/*-----------------------------------------------------------------------
+The tape is evaluated by one kernel per pattern width. The value of node
+n is a block of W 64-bit words at val[n*W], bit k of word j belonging
+to pattern 64*j+k, and a kernel evaluates each op on whole blocks: W=1
+is the portable scalar kernel, W=4 (256 patterns) is built for AVX2 and
+W=8 (512 patterns) for AVX-512. All three are instances of tapekernel()
+on a GCC vector type of W words; the wide ones are compiled with a
+target attribute, so the build needs no ISA flags and simdwords() picks
+the widest kernel the CPU supports at run time (see SIMD).
+-----------------------------------------------------------------------*/
+typedef void (*tapefn)(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMDX86 1
+typedef uint64_t v4u64 __attribute__((vector_size(32)));
+typedef uint64_t v8u64 __attribute__((vector_size(64)));
+#endif
+
+/* unaligned block load and store, so value arrays need no alignment */
+template<class V> static inline __attribute__((always_inline)) void ldblk(V &v, const uint64_t *p){
+    memcpy(&v, p, sizeof(V));
+}
+template<class V> static inline __attribute__((always_inline)) void stblk(uint64_t *p, const V &v){
+    memcpy(p, &v, sizeof(V));
+}
+
+/*-----------------------------------------------------------------------
+input: tape, its fanin slots, value array, range of tape ops
+output: nothing
+called by: the kernels below
+description:
+    Runs the tape ops from .. to-1 over val, V being the block of one
+    node (uint64_t or a vector of words).
+-----------------------------------------------------------------------*/
+template<class V> static inline __attribute__((always_inline))
+void tapekernel(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    const int W = sizeof(V) / sizeof(uint64_t);
+    const TSTRUC *op, *end = tape + to;
+    const uint32_t *f, *fend;
+    V r, x, zero = V();
+
+    for(op = tape + from; op < end; op++) {
+        f = tapefin + op->fin;
+        fend = f + op->nfin;
+        switch(op->op) {
+            case BRCH:
+            case BUFFER:
+                ldblk(r, val + (size_t) *f * W);
+                break;
+            case NOT:
+                ldblk(r, val + (size_t) *f * W);
+                r = ~r;
+                break;
+            case OR:
+            case NOR:
+                for(r = zero; f < fend; f++) {
+                    ldblk(x, val + (size_t) *f * W);
+                    r |= x;
+                }
+                if(op->op == NOR) r = ~r;
+                break;
+            case AND:
+            case NAND:
+                for(r = ~zero; f < fend; f++) {
+                    ldblk(x, val + (size_t) *f * W);
+                    r &= x;
+                }
+                if(op->op == NAND) r = ~r;
+                break;
+            case XOR:
+            case XNOR:
+                for(r = zero; f < fend; f++) {
+                    ldblk(x, val + (size_t) *f * W);
+                    r ^= x;
+                }
+                if(op->op == XNOR) r = ~r;
+                break;
+            default:
+                r = zero;
+                break;
+        }
+        stblk(val + (size_t) op->out * W, r);
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: tape, its fanin slots, value array, range of tape ops
+output: nothing
+called by: the kernels below
+description:
+    Three-valued counterpart of tapekernel(). The value of a node is a
+    pair of bit planes, ones at val[2*W*n] and zeros at val[2*W*n+W]:
+    a pattern is 1 if its bit is set in ones, 0 if set in zeros and X
+    if set in neither. A controlling input decides a gate whatever the
+    other inputs are (any 0 makes AND 0 even with X inputs), an X input
+    of XOR makes the output X, and inverting swaps the planes.
+-----------------------------------------------------------------------*/
+template<class V> static inline __attribute__((always_inline))
+void tapekernel3(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    const int W = sizeof(V) / sizeof(uint64_t);
+    const TSTRUC *op, *end = tape + to;
+    const uint32_t *f, *fend;
+    V o, z, xo, xz, t, zero = V();
+
+    for(op = tape + from; op < end; op++) {
+        f = tapefin + op->fin;
+        fend = f + op->nfin;
+        switch(op->op) {
+            case BRCH:
+            case BUFFER:
+            case NOT:
+                ldblk(o, val + (size_t) *f * 2 * W);
+                ldblk(z, val + (size_t) *f * 2 * W + W);
+                break;
+            case OR:
+            case NOR:
+                for(o = zero, z = ~zero; f < fend; f++) {
+                    ldblk(xo, val + (size_t) *f * 2 * W);
+                    ldblk(xz, val + (size_t) *f * 2 * W + W);
+                    o |= xo;
+                    z &= xz;
+                }
+                break;
+            case AND:
+            case NAND:
+                for(o = ~zero, z = zero; f < fend; f++) {
+                    ldblk(xo, val + (size_t) *f * 2 * W);
+                    ldblk(xz, val + (size_t) *f * 2 * W + W);
+                    o &= xo;
+                    z |= xz;
+                }
+                break;
+            case XOR:
+            case XNOR:
+                for(o = zero, z = ~zero; f < fend; f++) {
+                    ldblk(xo, val + (size_t) *f * 2 * W);
+                    ldblk(xz, val + (size_t) *f * 2 * W + W);
+                    t = (o & xz) | (z & xo);
+                    z = (z & xz) | (o & xo);
+                    o = t;
+                }
+                break;
+            default:
+                o = z = zero;
+                break;
+        }
+        if(op->op == NOT || op->op == NOR || op->op == NAND || op->op == XNOR) {
+            t = o;
+            o = z;
+            z = t;
+        }
+        stblk(val + (size_t) op->out * 2 * W, o);
+        stblk(val + (size_t) op->out * 2 * W + W, z);
+    }
+}
+
+static void tape64(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    tapekernel<uint64_t>(tape, tapefin, val, from, to);
+}
+
+static void tape64x(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    tapekernel3<uint64_t>(tape, tapefin, val, from, to);
+}
+
+#ifdef SIMDX86
+__attribute__((target("avx2")))
+static void tape256x(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    tapekernel3<v4u64>(tape, tapefin, val, from, to);
+}
+
+__attribute__((target("avx512f")))
+static void tape512x(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    tapekernel3<v8u64>(tape, tapefin, val, from, to);
+}
+
+__attribute__((target("avx2")))
+static void tape256(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    tapekernel<v4u64>(tape, tapefin, val, from, to);
+}
+
+__attribute__((target("avx512f")))
+static void tape512(const TSTRUC *tape, const uint32_t *tapefin, uint64_t *val, int from, int to){
+    tapekernel<v8u64>(tape, tapefin, val, from, to);
+}
+#endif
+
+const char *isaname[NISA] = {"scalar", "avx2", "avx512"};
+int Simd = -1;                  /* kernel ISA in use, -1 until chosen */
+
+/* 1 if the CPU can run the kernel of isa */
+static int isasupported(int isa){
+#ifdef SIMDX86
+    __builtin_cpu_init();
+    if(isa == ISA_AVX2) return __builtin_cpu_supports("avx2");
+    if(isa == ISA_AVX512) return __builtin_cpu_supports("avx512f");
+#endif
+    return isa == ISA_SCALAR;
+}
+
+/* kernel of nw words per node (per bit plane if three-valued) */
+static tapefn tapekern(int nw, int x3 = 0){
+#ifdef SIMDX86
+    if(nw == 8) return x3 ? tape512x : tape512;
+    if(nw == 4) return x3 ? tape256x : tape256;
+#endif
+    return x3 ? tape64x : tape64;
+}
+
+/*-----------------------------------------------------------------------
+input: kernel ISA, -1 for the widest supported
+output: the ISA in use, -1 if the CPU does not support isa
+called by: simd, simdwords, bench
+-----------------------------------------------------------------------*/
+int setsimd(int isa){
+    if(isa < 0) for(isa = NISA - 1; !isasupported(isa); isa--) ;
+    if(isa >= NISA || !isasupported(isa)) return -1;
+    return Simd = isa;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: 64-bit words per node of the kernel in use (1, 4 or 8)
+called by: logicsim_parallel, logicsim_shard, bench
+-----------------------------------------------------------------------*/
+int simdwords(){
+    if(Simd < 0) setsimd(-1);
+    return Simd == ISA_AVX512 ? 8 : Simd == ISA_AVX2 ? 4 : 1;
+}
+
+/*-----------------------------------------------------------------------
+input: kernel ISA
+output: number of mismatching pattern bits
+called by: simd
+description:
+    Checks the kernels of isa bit for bit against gatefunction(): every
+    gate type with 1 to 5 fanins is evaluated on random blocks and each
+    pattern of the result is compared with gatefunction() on the same
+    input bits. The three-valued kernel is checked on random 0/1/X
+    inputs against gatefunction() of all their 0/1 completions.
+-----------------------------------------------------------------------*/
+long kernelcheck(int isa){
+    static const int types[] = {BRCH, BUFFER, NOT, AND, NAND, OR, NOR, XOR, XNOR};
+    int nw = isa == ISA_AVX512 ? 8 : isa == ISA_AVX2 ? 4 : 1, ntype = sizeof(types) / sizeof(types[0]);
+    int i, t, k, nfin, nop = 0, nslot = 0, b;
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    long bad = 0;
+
+    vector<TSTRUC> tape;
+    vector<uint32_t> tapefin;
+    for(t = 0; t < ntype; t++)
+        for(nfin = 1; nfin <= (types[t] == BRCH || types[t] == BUFFER || types[t] == NOT ? 1 : 5); nfin++) {
+            TSTRUC op;
+            op.op = types[t];
+            op.fin = tapefin.size();
+            op.nfin = nfin;
+            for(k = 0; k < nfin; k++) tapefin.push_back(nslot++);
+            op.out = nslot++;
+            tape.push_back(op);
+            nop++;
+        }
+    vector<uint64_t> val((size_t) nslot * nw);
+    for(i = 0; i < (int) val.size(); i++) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        val[i] = seed;
+    }
+    tapekern(nw)(&tape[0], &tapefin[0], &val[0], 0, nop);
+
+    for(i = 0; i < nop; i++)
+        for(b = 0; b < 64 * nw; b++) {
+            vector<bool> in(tape[i].nfin);
+            for(k = 0; k < (int) tape[i].nfin; k++)
+                in[k] = (val[(size_t) tapefin[tape[i].fin + k] * nw + b / 64] >> (b % 64)) & 1;
+            if(gatefunction((enum e_gtype) tape[i].op, in) != (bool) ((val[(size_t) tape[i].out * nw + b / 64] >> (b % 64)) & 1))
+                bad++;
+        }
+
+    /* three-valued kernel: a known output must be the gatefunction() of
+       every 0/1 completion of the X inputs, an X output must differ
+       between two completions */
+    vector<uint64_t> val3((size_t) nslot * 2 * nw);
+    for(i = 0; i < nslot * nw; i++) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        val3[(i / nw) * 2 * nw + i % nw] = seed;                  /* ones */
+        val3[(i / nw) * 2 * nw + nw + i % nw] = ~seed & (seed >> 1 | seed << 63);   /* zeros */
+    }
+    tapekern(nw, 1)(&tape[0], &tapefin[0], &val3[0], 0, nop);
+    for(i = 0; i < nop; i++)
+        for(b = 0; b < 64 * nw; b++) {
+            int nf = tape[i].nfin, got, want = -2, m;
+            vector<int> v3(nf);
+            for(k = 0; k < nf; k++) {
+                size_t slot = (size_t) tapefin[tape[i].fin + k] * 2 * nw + b / 64;
+                v3[k] = (val3[slot] >> (b % 64)) & 1 ? 1 : (val3[slot + nw] >> (b % 64)) & 1 ? 0 : VALX;
+            }
+            for(m = 0; m < 1 << nf; m++) {
+                vector<bool> in(nf);
+                for(k = 0; k < nf; k++) {
+                    if(v3[k] != VALX && (m >> k & 1)) break;    /* each completion once */
+                    in[k] = v3[k] == VALX ? (m >> k & 1) : v3[k];
+                }
+                if(k < nf) continue;
+                got = gatefunction((enum e_gtype) tape[i].op, in);
+                want = want == -2 ? got : want == got ? want : VALX;
+            }
+            size_t out = (size_t) tape[i].out * 2 * nw + b / 64;
+            got = (val3[out] >> (b % 64)) & 1 ? 1 : (val3[out + nw] >> (b % 64)) & 1 ? 0 : VALX;
+            if(got != want) bad++;
+        }
+    return bad;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    SIMD [scalar|avx2|avx512|auto] selects the gate kernel of the
+    pattern-parallel simulators (LOGICSIM -P, -S and -X), or prints it.
+    SIMD -C checks every kernel the CPU supports against gatefunction().
+-----------------------------------------------------------------------*/
+void simd(){
+    char arg[MAXLINE];
+    int isa;
+
+    if(sscanf(cp, "%s", arg) == 1) {
+        if(strcasecmp(arg, "-C") == 0) {
+            for(isa = 0; isa < NISA; isa++) {
+                if(!isasupported(isa)) continue;
+                printf("%s: %ld mismatches against gatefunction()\n", isaname[isa], kernelcheck(isa));
+            }
+        }
+        else {
+            for(isa = 0; isa < NISA && strcasecmp(arg, isaname[isa]); isa++) ;
+            if(isa == NISA && strcasecmp(arg, "auto")) {
+                printf("Error: unknown kernel %s\n", arg);
+                return;
+            }
+            if(setsimd(isa == NISA ? -1 : isa) < 0) {
+                printf("Error: this CPU does not support %s\n", arg);
+                return;
+            }
+        }
+    }
+    simdwords();
+    printf("==> %s kernel, %d patterns per pass", isaname[Simd], 64 * simdwords());
+}
+
+/*==========================Threaded Simulator===========================*/
+/*-----------------------------------------------------------------------
+Persistent pool of Nthreads simulation threads, the caller being thread
+0. One pass of the tape runs phase by phase with a barrier after each
+phase. A parallel phase (one wide level) is cut into PARCHUNK-op chunks
+and every thread starts with an equal slice of them in its own deque: it
+takes chunks from the front of its deque and, once that is empty,
+steals from the back of the others. A deque is a packed [lo, hi) range
+updated with compare-and-swap. A merged phase of narrow levels is run
+by thread 0 alone. Gates of one level only read lower levels, so the
+values are exactly those of the serial tape. Any of the gate kernels
+can run a pass.
+-----------------------------------------------------------------------*/
+struct simpool {
+    struct deque {
+        std::atomic<uint64_t> r;    /* lo in the low, hi in the high 32 bits */
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    int nthr;
+    std::vector<std::thread> thr;
+    std::vector<deque> dq;
+    std::vector<int> sense;         /* barrier sense of each thread */
+    std::atomic<int> arrived, flag;
+    std::mutex m;
+    std::condition_variable cv;
+    long long job;                  /* number of passes posted */
+    int quit;
+    uint64_t *val;                  /* value array of the current pass */
+    tapefn fn;                      /* kernel of the current pass */
+
+    simpool(int n) : nthr(n), dq(n), sense(n, 0), arrived(0), flag(0), job(0), quit(0), val(NULL), fn(NULL){
+        for(int w = 1; w < nthr; w++) thr.push_back(std::thread(&simpool::worker, this, w));
+    }
+    ~simpool(){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            quit = 1;
+        }
+        cv.notify_all();
+        for(size_t i = 0; i < thr.size(); i++) thr[i].join();
+    }
+    /* one pass over the tape, run on all threads */
+    void sim(uint64_t *v, tapefn k){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            val = v;
+            fn = k;
+            job++;
+        }
+        cv.notify_all();
+        run(0);
+    }
+    void worker(int w){
+        long long seen = 0;
+
+        for(;;) {
+            std::unique_lock<std::mutex> lk(m);
+            while(job == seen && !quit) cv.wait(lk);
+            if(quit) return;
+            seen = job;
+            lk.unlock();
+            run(w);
+        }
+    }
+    void run(int w){
+        int p, from, to, nch;
+        long long c;
+
+        for(p = 0; p < Nphase; p++) {
+            from = Phasestart[p];
+            to = Phasestart[p + 1];
+            if(!Phasepar[p]) {
+                if(w == 0) fn(Tape, Tapefin, val, from, to);
+            }
+            else {
+                nch = (to - from + PARCHUNK - 1) / PARCHUNK;
+                dq[w].r.store(pack((long long) nch * w / nthr, (long long) nch * (w + 1) / nthr));
+                for(int v = 0; v < nthr; v++)
+                    while((c = take((w + v) % nthr, v == 0)) >= 0)
+                        fn(Tape, Tapefin, val, from + c * PARCHUNK, std::min(to, (int) (from + (c + 1) * PARCHUNK)));
+            }
+            barrier(w);
+        }
+    }
+    static uint64_t pack(uint64_t lo, uint64_t hi){
+        return lo | hi << 32;
+    }
+    /* next chunk of deque d, from the front for its owner; -1 if empty */
+    long long take(int d, int own){
+        uint64_t r = dq[d].r.load(), lo, hi;
+
+        for(;;) {
+            lo = r & 0xffffffff;
+            hi = r >> 32;
+            if(lo >= hi) return -1;
+            if(own ? dq[d].r.compare_exchange_weak(r, pack(lo + 1, hi))
+                   : dq[d].r.compare_exchange_weak(r, pack(lo, hi - 1)))
+                return own ? lo : hi - 1;
+        }
+    }
+    /* sense-reversing barrier; yields while waiting so that more threads
+       than cores still make progress */
+    void barrier(int w){
+        int s = sense[w] = !sense[w], spin = 0;
+
+        if(arrived.fetch_add(1) == nthr - 1) {
+            arrived.store(0);
+            flag.store(s);
+        }
+        else while(flag.load() != s)
+            if(++spin > 1000) std::this_thread::yield();
+    }
+};
+
+static simpool *Pool;           /* NULL while Nthreads is 1 */
+
+/*-----------------------------------------------------------------------
+input: number of threads, 0 for one per core
+output: number of threads in use
+called by: threads, bench
+description:
+    Sets Nthreads and starts (or stops) the thread pool to match.
+-----------------------------------------------------------------------*/
+int setthreads(int n){
+    if(n <= 0) n = std::thread::hardware_concurrency();
+    if(n <= 0) n = 1;
+    if(n != Nthreads || (n > 1) != (Pool != NULL)) {
+        delete Pool;
+        Pool = n > 1 ? new simpool(n) : NULL;
+        Nthreads = n;
+    }
+    return Nthreads;
+}
+
+/*-----------------------------------------------------------------------
+input: value array of nw words per node (1, or simdwords())
+output: nothing
+called by: tapesim, logicsim_parallel, bench
+description:
+    Runs the compiled tape over val with the native simulator if one is
+    loaded (see CODEGEN), else with the kernel of nw words, on the
+    thread pool when THREADS is more than 1 and on the calling thread
+    otherwise.
+-----------------------------------------------------------------------*/
+void tapesimw(uint64_t *val, int nw){
+    if(Native && Native(val, nw) == 0) ;
+    else if(Pool) Pool->sim(val, tapekern(nw));
+    else tapekern(nw)(Tape, Tapefin, val, 0, Ntape);
+    Stats.gateevals += (long long) Ntape * nw;
+}
+
+/*-----------------------------------------------------------------------
+input: value array of two bit planes of nw words per node
+output: nothing
+called by: logicsim3
+description:
+    Three-valued counterpart of tapesimw().
+-----------------------------------------------------------------------*/
+void tapesim3(uint64_t *val, int nw){
+    if(Pool) Pool->sim(val, tapekern(nw, 1));
+    else tapekern(nw, 1)(Tape, Tapefin, val, 0, Ntape);
+    Stats.gateevals += (long long) Ntape * nw;
+}
+
+/*-----------------------------------------------------------------------
+input: value array indexed by node
+output: nothing
+called by: circuit_value_calculation, faultsim
+description:
+    Runs the compiled tape over val, one 64-bit word per node.
+-----------------------------------------------------------------------*/
+void tapesim(uint64_t *val){
+    tapesimw(val, 1);
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    THREADS [n] sets the number of simulation threads (0: one per core)
+    or prints it. The threaded simulator gives the same results as the
+    serial one; it pays off on circuits with wide levels.
+-----------------------------------------------------------------------*/
+void threads(){
+    int n;
+
+    if(sscanf(cp, "%d", &n) == 1) setthreads(n);
+    printf("==> %d simulation thread%s", Nthreads, Nthreads > 1 ? "s" : "");
+}
+
+/*=========================Native Code Generator==========================*/
+/*-----------------------------------------------------------------------
+CODEGEN lowers the compiled tape into straight-line C, one bitwise
+expression per gate on the value blocks of its fanins, compiles it with
+the system compiler into a shared object and loads it with dlopen(). The
+node indices are constants of the generated code, so it skips the tape
+decoding and fanin indirection of the gate kernels. The code is
+instantiated for blocks of 1, 4 and 8 words (see SIMD) and exports
+
+    ckt_id      the tapehash() it was generated for
+    ckt_sim     int ckt_sim(uint64_t *val, int nw), 0 on success
+
+The object is kept in the cache directory as ckt_<hash>.so, so a later
+CODEGEN or LOGICSIM of the same netlist, in this or another process,
+only loads it. Loading runs the code of the object, so the default cache
+is private to the user ($XDG_CACHE_HOME/readckt, mode 0700), the files
+are built in a fresh mkdtemp() directory and an object is only loaded if
+the user owns it and nobody else can write it.
+-----------------------------------------------------------------------*/
+#define NATIVEVER 1                 /* version of the generated code */
+#define NATIVECHUNK 128             /* gates per generated function */
+#define NATIVEFLAGS "-O1 -march=native -shared -fPIC -w"
+
+static void *Nativelib;         /* dlopen() handle of Native */
+
+static uint64_t hashmix(uint64_t h, uint64_t v){
+    return (h ^ v) * 0x100000001b3ULL;
+}
+
+/* compiler command: $CC, cc if unset */
+static string nativecc(){
+    const char *cc = getenv("CC");
+    return string(cc && *cc ? cc : "cc") + " " + NATIVEFLAGS;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: 64-bit hash of the compiled circuit
+called by: loadnative
+description:
+    FNV-1a style hash of everything the generated code depends on: the
+    ops of the tape with their fanin slots, the number of nodes, the
+    generator version and the compiler command.
+-----------------------------------------------------------------------*/
+uint64_t tapehash(){
+    uint64_t h = 0xcbf29ce484222325ULL;
+    string cc = nativecc();
+    uint32_t k;
+    int i;
+
+    h = hashmix(h, NATIVEVER);
+    h = hashmix(h, Nnodes);
+    h = hashmix(h, Ntape);
+    for(i = 0; i < (int) cc.size(); i++) h = hashmix(h, (unsigned char) cc[i]);
+    for(i = 0; i < Ntape; i++) {
+        h = hashmix(h, Tape[i].op);
+        h = hashmix(h, Tape[i].out);
+        h = hashmix(h, Tape[i].nfin);
+        for(k = Tape[i].fin; k < Tape[i].fin + Tape[i].nfin; k++) h = hashmix(h, Tapefin[k]);
+    }
+    return h;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: the default cache directory of CODEGEN, empty if there is none
+called by: codegen
+description:
+    $XDG_CACHE_HOME/readckt, else ~/.cache/readckt, else
+    /tmp/readckt-<uid>, created with mode 0700. An existing directory is
+    refused unless it is the user's own and only the user can write it.
+-----------------------------------------------------------------------*/
+static string nativedefault(){
+    const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+    string dir;
+    struct stat sb;
+
+    if(xdg && *xdg == '/') {
+        mkdir(xdg, 0700);
+        dir = string(xdg) + "/readckt";
+    }
+    else if(home && *home == '/') {
+        dir = string(home) + "/.cache";
+        mkdir(dir.c_str(), 0700);
+        dir += "/readckt";
+    }
+    else dir = "/tmp/readckt-" + to_string((long) geteuid());
+    mkdir(dir.c_str(), 0700);
+    if(lstat(dir.c_str(), &sb) < 0 || !S_ISDIR(sb.st_mode) || sb.st_uid != geteuid() ||
+       (sb.st_mode & (S_IWGRP | S_IWOTH))) {
+        printf("Error: %s is not a private directory\n", dir.c_str());
+        return "";
+    }
+    return dir;
+}
+
+/* opens the object name to check it before dlopen(); -1 unless it is a
+   regular file of the user that nobody else can write, and not a link */
+static int opennative(const char *name){
+    struct stat sb;
+    int fd;
+
+    if((fd = open(name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) < 0) return -1;
+    if(fstat(fd, &sb) < 0 || !S_ISREG(sb.st_mode) || sb.st_uid != geteuid() ||
+       (sb.st_mode & (S_IWGRP | S_IWOTH))) {
+        close(fd);
+        errno = EPERM;
+        return -1;
+    }
+    return fd;
+}
+
+static void emits(vecwriter &out, const char *s){
+    out.write(s, strlen(s));
+}
+
+/*-----------------------------------------------------------------------
+input: source file name, circuit hash
+output: 0 on success, -1 if the file cannot be written
+called by: loadnative
+description:
+    Writes the C source of the native simulator of the compiled tape.
+    The gates are cut into functions of NATIVECHUNK gates, as the
+    compile time grows faster than the function size. The body of a
+    chunk is a macro expanded once per block width. Values computed
+    before the chunk are loaded into locals up front, so the gates only
+    read locals and no store can alias a later load.
+-----------------------------------------------------------------------*/
+static int emitnative(const char *name, uint64_t hash){
+    vecwriter out;
+    char line[160];
+    int i, c, w, from, to, nchunk = (Ntape + NATIVECHUNK - 1) / NATIVECHUNK;
+    uint32_t k;
+    static const char *opname[] = {"", "", "^", "|", "|", "", "&", "&", "^", ""};
+    vector<int> mark(Nnodes, 0), load(Nnodes, 0);
+
+    if(out.open(name, O_EXCL | O_NOFOLLOW) < 0) return -1;
+    emits(out, "/* Native simulator generated by CODEGEN, do not edit. */\n"
+               "#include <stdint.h>\n\n"
+               "typedef uint64_t w1;\n"
+               "typedef uint64_t w4 __attribute__((vector_size(32), aligned(8)));\n"
+               "typedef uint64_t w8 __attribute__((vector_size(64), aligned(8)));\n"
+               "#define G(n) (*(const V *) (val + (n) * W))\n"
+               "#define S(n, v) (*(V *) (val + (n) * W) = (v))\n");
+    for(c = 0; c < nchunk; c++) {
+        from = c * NATIVECHUNK;
+        to = min(Ntape, from + NATIVECHUNK);
+        snprintf(line, sizeof(line), "\n#define C%d \\\n", c);
+        emits(out, line);
+        for(i = from; i < to; i++) mark[Tape[i].out] = c + 1;
+        for(i = from; i < to; i++)
+            for(k = Tape[i].fin; k < Tape[i].fin + Tape[i].nfin; k++) {
+                if(mark[Tapefin[k]] == c + 1 || load[Tapefin[k]] == c + 1) continue;
+                load[Tapefin[k]] = c + 1;
+                emits(out, "    const V n");
+                out.putint(Tapefin[k]);
+                emits(out, " = G(");
+                out.putint(Tapefin[k]);
+                emits(out, "); \\\n");
+            }
+        for(i = from; i < to; i++) {
+            const TSTRUC &t = Tape[i];
+            int inv = t.op == NOR || t.op == NAND || t.op == XNOR || t.op == NOT;
+
+            emits(out, "    const V n");
+            out.putint(t.out);
+            emits(out, inv ? " = ~(" : " = ");
+            for(k = t.fin; k < t.fin + t.nfin; k++) {
+                if(k > t.fin) { out.put(' '); emits(out, opname[t.op]); out.put(' '); }
+                out.put('n');
+                out.putint(Tapefin[k]);
+            }
+            emits(out, inv ? "); S(" : "; S(");
+            out.putint(t.out);
+            emits(out, ", n");
+            out.putint(t.out);
+            emits(out, i + 1 < to ? "); \\\n" : ");\n");
+        }
+        for(w = 1; w <= 8; w *= 2) {
+            if(w == 2) continue;
+            snprintf(line, sizeof(line), "static void c%d_%d(uint64_t *val){ typedef w%d V; enum { W = %d }; C%d }\n", c, w, w, w, c);
+            emits(out, line);
+        }
+    }
+    snprintf(line, sizeof(line), "\nconst unsigned long long ckt_id = 0x%016llxULL;\n", (unsigned long long) hash);
+    emits(out, line);
+    emits(out, "\nint ckt_sim(uint64_t *val, int nw){\n    switch(nw) {\n");
+    for(w = 1; w <= 8; w *= 2) {
+        if(w == 2) continue;
+        snprintf(line, sizeof(line), "    case %d:\n", w);
+        emits(out, line);
+        for(c = 0; c < nchunk; c++) {
+            snprintf(line, sizeof(line), "        c%d_%d(val);\n", c, w);
+            emits(out, line);
+        }
+        emits(out, "        return 0;\n");
+    }
+    emits(out, "    }\n    return -1;\n}\n");
+    return out.close();
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: clear, compile, codegen
+description:
+    Unloads the native simulator; it is only valid for the tape it was
+    generated from.
+-----------------------------------------------------------------------*/
+void freenative(){
+    if(Nativelib) dlclose(Nativelib);
+    Nativelib = NULL;
+    Native = NULL;
+}
+
+/*-----------------------------------------------------------------------
+input: recompile even if the cache has the object
+output: 0 on success, -1 on failure
+called by: codegen, logicsim
+description:
+    Loads the native simulator of the compiled tape from Nativedir,
+    generating and compiling it first unless the cache already has it.
+    The source and object are written in a private temporary directory
+    and renamed into place, so concurrent runs never load a partial file
+    and no link planted in the cache is followed. The object must pass
+    opennative() before dlopen() runs any of its code.
+-----------------------------------------------------------------------*/
+int loadnative(int force){
+    uint64_t hash;
+    char base[MAXNAME], tmp[MAXNAME + 32];
+    string cmd, src, obj;
+    double t0 = seconds();
+    struct stat sb;
+    const unsigned long long *id;
+    int cached, fd;
+
+    freenative();
+    if(Tapelev == NULL && compile() < 0) return -1;
+    hash = tapehash();
+    snprintf(base, sizeof(base), "%s/ckt_%016llx", Nativedir.c_str(), (unsigned long long) hash);
+    cached = !force && lstat((string(base) + ".so").c_str(), &sb) == 0;
+    if(!cached) {
+        snprintf(tmp, sizeof(tmp), "%s.XXXXXX", base);
+        if(mkdtemp(tmp) == NULL) {
+            printf("Error: cannot write in %s\n", Nativedir.c_str());
+            return -1;
+        }
+        src = string(tmp) + "/ckt.c";
+        obj = string(tmp) + "/ckt.so";
+        if(emitnative(src.c_str(), hash) < 0) {
+            printf("Error: cannot write %s\n", src.c_str());
+            unlink(src.c_str());
+            rmdir(tmp);
+            return -1;
+        }
+        cmd = nativecc() + " -o " + obj + " " + src;
+        VERB(1) printf("%s\n", cmd.c_str());
+        if(system(cmd.c_str()) != 0 || chmod(obj.c_str(), 0755) < 0 || rename(obj.c_str(), (string(base) + ".so").c_str()) < 0) {
+            printf("Error: cannot compile %s.c\n", base);
+            unlink(obj.c_str());
+            unlink(src.c_str());
+            rmdir(tmp);
+            return -1;
+        }
+        if(rename(src.c_str(), (string(base) + ".c").c_str()) < 0) unlink(src.c_str());
+        rmdir(tmp);
+    }
+    if((fd = opennative((string(base) + ".so").c_str())) < 0) {
+        printf("Error: not loading %s.so: %s\n", base,
+               errno == EPERM ? "not the user's own or writable by others" : strerror(errno));
+        return -1;
+    }
+    Nativelib = dlopen((string(base) + ".so").c_str(), RTLD_NOW | RTLD_LOCAL);
+    close(fd);
+    if(Nativelib == NULL) {
+        printf("Error: %s\n", dlerror());
+        return -1;
+    }
+    id = (const unsigned long long *) dlsym(Nativelib, "ckt_id");
+    Native = (nativefn) dlsym(Nativelib, "ckt_sim");
+    if(id == NULL || *id != hash || Native == NULL) {
+        printf("Error: %s.so does not match the circuit, rerun with CODEGEN -F\n", base);
+        freenative();
+        return -1;
+    }
+    VERB(1) printf("native simulator %s.so %s in %.2f s\n", base, cached ? "loaded" : "built", seconds() - t0);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    CODEGEN [-F] [dir] builds or loads the native simulator of the
+    circuit, with dir (default see nativedefault) as the cache; -F
+    recompiles. From
+    then on the simulators call it instead of the gate kernels, also for
+    circuits read later. It runs a pass on one thread, so THREADS only
+    helps through LOGICSIM -S. CODEGEN OFF returns to the gate kernels.
+-----------------------------------------------------------------------*/
+void codegen(){
+    stringstream st(cp);
+    string arg;
+    int force = 0;
+
+    while(st>>arg) {
+        if(arg == "-F" || arg == "-f") force = 1;
+        else if(arg == "OFF" || arg == "off") {
+            freenative();
+            Nativedir.clear();
+            printf("==> gate kernels");
+            return;
+        }
+        else Nativedir = arg;
+    }
+    if(Nativedir.empty() && (Nativedir = nativedefault()).empty()) return;
+    if(Gstate != CKTLD) {
+        printf("==> native simulation on, cache %s", Nativedir.c_str());
+        return;
+    }
+    if(loadnative(force) == 0) printf("==> native simulator of %d gates", Ntape);
+}
+
+/*===========================Logic Simulator*===========================*/
+//Those void functions below are used in logicsim()
+/*-----------------------------------------------------------------------
+Buffered reader of vector files (see readckt.h). The file is read through
+a fixed buffer with read(2) and parsed in place, so memory does not grow
+with the file.
+-----------------------------------------------------------------------*/
+int vecreader::open(const char *name){
+    close();
+    if((fd = ::open(name, O_RDONLY)) < 0) return -1;
+    size = 1 << 20;
+    buf = (char *) malloc(size);
+    own = 1;
+    pos = len = 0;
+    eof = nline = nbad = 0;
+    return 0;
+}
+
+/* reads the text [s, e) already in memory, whose first line is line0+1 */
+void vecreader::openmem(const char *s, const char *e, int line0){
+    close();
+    buf = (char *) s;
+    own = 0;
+    size = len = e - s;
+    pos = 0;
+    nline = line0;
+    nbad = 0;
+}
+
+void vecreader::close(){
+    if(fd >= 0) ::close(fd);
+    if(own) free(buf);
+    fd = -1;
+    buf = NULL;
+    own = 0;
+    eof = 1;
+}
+
+/* next line in [s, e) without the newline; 0 at end of file */
+int vecreader::getline(const char *&s, const char *&e){
+    char *nl;
+    ssize_t n;
+
+    while((nl = (char *) memchr(buf + pos, '\n', len - pos)) == NULL && !eof) {
+        if(pos > 0) {
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+        }
+        if(len == size) buf = (char *) realloc(buf, size *= 2);
+        if((n = read(fd, buf + len, size - len)) <= 0) eof = 1;
+        else {
+            len += n;
+            Stats.bytes += n;
+        }
+    }
+    if(nl == NULL && pos == len) return 0;
+    s = buf + pos;
+    e = nl ? nl : buf + len;
+    pos = nl ? nl + 1 - buf : len;
+    nline++;
+    return 1;
+}
+
+/* loads the next vector into pival (PIs in Pinput order); 0 at end */
+int vecreader::next(vector<int> &pival){
+    const char *s, *e;
+    int nread = 0, PI_ID, PI_value;
+
+    while(getline(s, e)) {
+        while(s < e && isspace(*s)) s++;
+        if(s == e) {
+            if(nread) return 1;
+            continue;       //skip repeated separators
+        }
+        nread++;
+        if(!scanint(s, e, PI_ID, ",") || s == e || *s++ != ',' || !scanvalue(s, e, PI_value)) {
+            cerr<<"Error: line "<<nline<<": malformed vector line"<<endl;
+            if(!nbad++) badline = nline;
+            continue;
+        }
+        if(PI_ID < 0 || PI_ID >= Npislot || Pislot[PI_ID] < 0) {
+            cerr<<"Error: line "<<nline<<": "<<PI_ID<<" is not a primary input"<<endl;
+            if(!nbad++) badline = nline;
+            continue;
+        }
+        pival[Pislot[PI_ID]] = PI_value;
+    }
+    return nread > 0;
+}
+
+/*-----------------------------------------------------------------------
+Buffered writer for the simulation results. Lines are formatted into a
+large buffer that is written out with write(2) only when it fills up.
+-----------------------------------------------------------------------*/
+/* flags are added to O_WRONLY | O_CREAT, O_EXCL | O_NOFOLLOW for a new file */
+int vecwriter::open(const char *name, int flags){
+    close();
+    if((fd = ::open(name, O_WRONLY | O_CREAT | flags, 0644)) < 0) return -1;
+    buf = (char *) malloc(SIZE);
+    len = 0;
+    err = 0;
+    return 0;
+}
+
+/* writes all of [s, s+n), retrying short and interrupted writes; after a
+   failure nothing more is written */
+void vecwriter::writeall(const char *s, size_t n){
+    ssize_t k;
+
+    while(n > 0 && !err) {
+        if((k = ::write(fd, s, n)) < 0) {
+            if(errno != EINTR) err = errno;
+            continue;
+        }
+        if(k == 0) err = ENOSPC;
+        s += k;
+        n -= k;
+    }
+}
+
+void vecwriter::flush(){
+    writeall(buf, len);
+    len = 0;
+}
+
+/* -1 with errno set if any write failed */
+int vecwriter::close(){
+    int e;
+
+    if(fd < 0) return 0;
+    flush();
+    if(::close(fd) < 0 && !err) err = errno;
+    free(buf);
+    fd = -1;
+    buf = NULL;
+    e = err;
+    err = 0;
+    if(!e) return 0;
+    errno = e;
+    return -1;
+}
+
+void vecwriter::write(const char *s, size_t n){
+    if(len + n > SIZE) flush();
+    if(n > SIZE) {
+        writeall(s, n);
+        return;
+    }
+    memcpy(buf + len, s, n);
+    len += n;
+}
+
+void vecwriter::putint(long long v){
+    char tmp[24];
+    int n = 0;
+    unsigned long long u = v < 0 ? -(unsigned long long)v : v;
+
+    if(len + 24 > SIZE) flush();
+    do tmp[n++] = '0' + u % 10; while(u /= 10);
+    if(v < 0) buf[len++] = '-';
+    while(n) buf[len++] = tmp[--n];
+}
+
+/* one "num,value" line per PO */
+void vecwriter::poline(unsigned num, int value){
+    putint(num);
+    put(',');
+    if(value == VALX) put('X');
+    else putint(value);
+    put('\n');
+}
+
+vecreader Vin;                  /* vector file of the serial LOGICSIM */
+vecwriter Vout;                 /* output file of the serial LOGICSIM */
+vector<int> Vpival;             /* current PI values, in Pinput order */
+
+//Read the next vector of the input file into the PIs, 0 at end of file
+int readfile(){
+    if(!Vin.next(Vpival)) return 0;
+    VERB(2) cout<<endl<<"******Start read the input file**********"<<endl;
+    VERB(2) cout << "Name of the input file: " << inputFilename << endl;
+    for(int i=0;i<Npi;i++){
+        Pinput[i]->value=Vpival[i];
+    }
+    //Check the values we load on terminal
+    for(int j=0;j<Npi;j++){
+        VERB(2) cout<<"PI No."<<j<<", "<<Pinput[j]->value<<endl;
+    }
+    VERB(2) cout<<"************Finish Read values to PI in readfile()***********"<<endl<<endl;
+    return 1;
+}
+
+bool gatefunction(enum e_gtype type, vector<bool>inputvalue){//IPT, BRCH XOR, OR, NOR, NOT, NAND, AND,XNOR, BUFFER
+    bool result = false;
+    switch(type){
+        case BRCH:
+            result=inputvalue[0];
+            break;
+        case OR:
+            result=0;//noncontrolling value
+            for(size_t i=0;i<inputvalue.size();i++){
+                result|=inputvalue[i];
+            }
+            break;
+        case XOR:
+            result=0;
+            for(size_t i=0;i<inputvalue.size();i++){
+                result^=inputvalue[i];
+            }   
+            break; 
+        case NOR:
+            result=0;
+            for(size_t i=0;i<inputvalue.size();i++){
+                result|=inputvalue[i];
+            }   
+            result=!result;
+            break; 
+         case NOT:
+            result=!inputvalue[0]; 
+            break;
+        case NAND:
+            result=1;
+            for(size_t i=0;i<inputvalue.size();i++){
+                result&=inputvalue[i];
+            }
+            result=!result;    
+            break;
+        case AND:
+            result=1;
+            for(size_t i=0;i<inputvalue.size();i++){
+                result&=inputvalue[i];
+            }    
+            break;
+        case XNOR:
+            result=0;
+            for(size_t i=0;i<inputvalue.size();i++){
+                result^=inputvalue[i];
+            }    
+            result=!result; 
+            break;
+        case BUFFER:
+            result = inputvalue[0];
+            break;
+        
+        default:
+        cerr<<"Error in Logic Gate Calculation"<<endl<<endl;;
+        break;
+    }
+    return result;
+}
+void circuit_value_calculation(){
+    VERB(2) cout<<"*****Start gate calculation in circuit_value_calculation()*****"<<endl;
+    //The compiled tape does the work, bit 0 of Pvalue carries the node values
+    for(int i=0;i<Nnodes;i++){
+        Pvalue[i]=Node[i].value > 0 ? ~(uint64_t)0 : 0;   //X reads as 0
+    }
+    tapesim(Pvalue);
+    for(int k=0;k<Ntape;k++){
+        Node[Tape[k].out].value=Pvalue[Tape[k].out]&1;
+    }
+    VERB(2) for(int currentLevel=0;currentLevel<Nlevels;currentLevel++){
+        cout << "Processing gates at level: " << currentLevel<<endl;
+        for(int k=Tapelev[currentLevel];k<Tapelev[currentLevel+1];k++){
+            int i=Tape[k].out;
+            cout<< "This "<<gname(Node[i].type)<<" output is "<<Node[i].value<<endl;
+        }
+    }
+    VERB(2) cout<<"*****Finish gate calculation in circuit_value_calculation() and gatefunction()*****"<<endl<<endl;
+}
+//Append the PO values of vector nvec, vectors are separated by a blank line
+void outfilewriting(int nvec){
+    VERB(2) cout<<"*****Start Writing the output file****"<<endl;
+    VERB(2) cout<<"Output File Name is "<<outputFilename<<endl;
+    if(nvec>0) Vout.put('\n');
+    for(int i=0;i<Npo;i++){
+        Vout.poline(Poutput[i]->num, Poutput[i]->value);
+        VERB(2) cout<< "The gate of Primary Output is "<<gname(Poutput[i]->type)<<",Node number is "<<Poutput[i]->num<<", the gateoutput is "<<Poutput[i]->value<<endl;
+    }
+    VERB(2) cout<<"*****Finish Writing the output file*****"<<endl<<endl;
+}
+/*-----------------------------------------------------------------------
+input: vector reader, current PI values, PI words, words per PI
+output: number of vectors loaded (0 at end of file)
+called by: logicsim_parallel, logicsim_event, logicsim_timed, simshard, faultsim
+description:
+    Loads up to 64*nw vectors into piword, one packed block of nw words
+    per primary input in Pinput order. Like readfile(), a PI missing
+    from a vector keeps the value it had in the previous one, tracked in
+    pival. An X reads as 0 in the two-valued simulators (see readblock3).
+-----------------------------------------------------------------------*/
+int readblock(vecreader &in, vector<int> &pival, vector<uint64_t> &piword, int nw){
+    int i, npat;
+
+    piword.assign((size_t) Npi * nw, 0);
+    for(npat = 0; npat < 64 * nw && in.next(pival); npat++)
+        for(i = 0; i < Npi; i++)
+            if(pival[i] > 0) piword[(size_t) i * nw + npat / 64] |= (uint64_t)1 << (npat % 64);
+    return npat;
+}
+
+/*-----------------------------------------------------------------------
+input: vector file name, output file name
+output: nothing
+called by: logicsim
+description:
+    Pattern-parallel logic simulation (LOGICSIM -P). Every block of 64,
+    256 or 512 vectors, as wide as the gate kernel (see SIMD), is
+    simulated with one pass over the compiled tape. For every
+    vector the PO lines are the same as the ones outfilewriting()
+    produces; the blocks of consecutive vectors are separated by a blank
+    line.
+-----------------------------------------------------------------------*/
+void logicsim_parallel(const string &infile, const string &outfile){
+    int i, p, npat, nvec = 0;
+    simstate st;
+    vecreader in;
+    vecwriter out;
+
+    if(in.open(infile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(out.open(outfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    st.init(simdwords());
+    for(i = 0; i < Npi; i++) st.pival[i] = Pinput[i]->value;
+    while((npat = readblock(in, st.pival, st.piword, st.nw)) > 0) {
+        for(i = 0; i < Npi; i++)
+            memcpy(&st.val[(size_t) Pinput[i]->indx * st.nw], &st.piword[(size_t) i * st.nw], st.nw * sizeof(uint64_t));
+        tapesimw(&st.val[0], st.nw);
+        for(p = 0; p < npat; p++, nvec++) {
+            if(nvec > 0) out.put('\n');
+            for(i = 0; i < Npo; i++)
+                out.poline(Poutput[i]->num, st.bit(Poutput[i]->indx, p));
+        }
+        //Leave the node values of the last vector, as the serial simulator does
+        for(i = 0; i < Nnodes; i++) Node[i].value = st.bit(i, npat - 1);
+    }
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    Stats.vectors += nvec;
+    printf("==> %d vectors simulated", nvec);
+}
+
+/*======================Three-valued Logic Simulator======================*/
+/*-----------------------------------------------------------------------
+input: vector reader, PI values, PI words, words per bit plane
+output: number of vectors loaded (0 at end of file)
+called by: logicsim3
+description:
+    Loads up to 64*nw partially specified vectors into piword: for every
+    primary input a ones plane of nw words then a zeros plane of nw
+    words (see tapekernel3()). A PI that a vector does not list, or
+    lists as X, is X in that vector.
+-----------------------------------------------------------------------*/
+int readblock3(vecreader &in, vector<int> &pival, vector<uint64_t> &piword, int nw){
+    int i, npat;
+    uint64_t bit;
+    size_t w;
+
+    piword.assign((size_t) Npi * 2 * nw, 0);
+    for(npat = 0; npat < 64 * nw; npat++) {
+        pival.assign(Npi, VALX);
+        if(!in.next(pival)) break;
+        bit = (uint64_t)1 << (npat % 64);
+        for(i = 0; i < Npi; i++) {
+            if(pival[i] == VALX) continue;
+            w = (size_t) i * 2 * nw + npat / 64;
+            piword[pival[i] > 0 ? w : w + nw] |= bit;
+        }
+    }
+    return npat;
+}
+
+/*-----------------------------------------------------------------------
+input: vector file name, output file name
+output: nothing
+called by: logicsim
+description:
+    Three-valued logic simulation (LOGICSIM -X) of partially specified
+    vectors. Values are 0, 1 or X, a PI not given in a vector being X,
+    and the PO lines report X where the output is not decided by the
+    specified inputs. Vectors are simulated a kernel block at a time
+    like LOGICSIM -P, with two bit planes per node.
+-----------------------------------------------------------------------*/
+void logicsim3(const string &infile, const string &outfile){
+    int i, p, npat, nvec = 0, nw = simdwords(), o, z;
+    vector<int> pival(Npi);
+    vector<uint64_t> piword, val((size_t) Nnodes * 2 * nw);
+    vecreader in;
+    vecwriter out;
+
+    if(in.open(infile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(out.open(outfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    while((npat = readblock3(in, pival, piword, nw)) > 0) {
+        for(i = 0; i < Npi; i++)
+            memcpy(&val[(size_t) Pinput[i]->indx * 2 * nw], &piword[(size_t) i * 2 * nw], 2 * nw * sizeof(uint64_t));
+        tapesim3(&val[0], nw);
+        for(p = 0; p < npat; p++, nvec++) {
+            if(nvec > 0) out.put('\n');
+            for(i = 0; i < Npo; i++) {
+                o = (val[(size_t) Poutput[i]->indx * 2 * nw + p / 64] >> (p % 64)) & 1;
+                z = (val[(size_t) Poutput[i]->indx * 2 * nw + nw + p / 64] >> (p % 64)) & 1;
+                out.poline(Poutput[i]->num, o ? 1 : z ? 0 : VALX);
+            }
+        }
+        //Leave the node values of the last vector, as the serial simulator does
+        p = npat - 1;
+        for(i = 0; i < Nnodes; i++) {
+            o = (val[(size_t) i * 2 * nw + p / 64] >> (p % 64)) & 1;
+            z = (val[(size_t) i * 2 * nw + nw + p / 64] >> (p % 64)) & 1;
+            Node[i].value = o ? 1 : z ? 0 : VALX;
+        }
+    }
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    Stats.vectors += nvec;
+    printf("==> %d vectors simulated", nvec);
+}
+
+/*=========================Output Cone Simulator==========================*/
+/*-----------------------------------------------------------------------
+The union of the fan-in cones of a set of primary outputs, for LOGICSIM
+-O: the tape ops of the gates in the cones, in tape (level) order, with
+their fanin slots still in Tapefin. Cones are cached in Cones by their
+PO set until the tape is rebuilt (next LEV or READ).
+-----------------------------------------------------------------------*/
+struct conestruc {
+    std::vector<int> po;            /* Poutput indices, sorted */
+    std::vector<TSTRUC> tape;       /* ops of the cone gates */
+    std::vector<int> pi;            /* Pinput indices of the PIs in the cone */
+    int nnode;                      /* nodes in the cone */
+};
+
+static vector<conestruc> Cones;
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: clear, compile
+description:
+    Drops the cached output cones; they refer to Tape and Tapefin.
+-----------------------------------------------------------------------*/
+void freecones(){
+    vector<conestruc>().swap(Cones);
+}
+
+/*-----------------------------------------------------------------------
+input: comma separated list of PO node numbers
+output: the cone of those POs, NULL on a bad list
+called by: logicsim
+description:
+    Returns the cached cone of the POs, or walks the fanins (Ckt.fanin)
+    back from the POs to mark their cones and keeps the tape ops and PIs
+    that fall inside. A node shared by several cones is simulated once.
+-----------------------------------------------------------------------*/
+static conestruc *findcone(const string &list){
+    vector<int> po;
+    const char *p = list.c_str(), *e = p + list.size();
+    int v, i;
+    size_t c;
+    uint32_t n, k;
+
+    while(p < e) {
+        if(!scanint(p, e, v, ",")) break;
+        for(i = 0; i < Npo && (int) Poutput[i]->num != v; i++) ;
+        if(i == Npo) {
+            printf("Error: %d is not a primary output\n", v);
+            return NULL;
+        }
+        po.push_back(i);
+        if(p < e && *p == ',') p++;
+    }
+    if(p < e || po.empty()) {
+        printf("Error: malformed primary output list %s\n", list.c_str());
+        return NULL;
+    }
+    sort(po.begin(), po.end());
+    po.erase(unique(po.begin(), po.end()), po.end());
+    for(c = 0; c < Cones.size(); c++)
+        if(Cones[c].po == po) return &Cones[c];
+
+    Cones.push_back(conestruc());
+    conestruc &cn = Cones.back();
+    vector<char> in(Nnodes, 0);
+    vector<uint32_t> stack;
+    cn.po = po;
+    cn.nnode = 0;
+    for(c = 0; c < po.size(); c++) {
+        stack.push_back(Poutput[po[c]]->indx);
+        in[Poutput[po[c]]->indx] = 1;
+    }
+    while(!stack.empty()) {
+        n = stack.back();
+        stack.pop_back();
+        cn.nnode++;
+        for(k = Ckt.finoff[n]; k < Ckt.finoff[n + 1]; k++)
+            if(!in[Ckt.fanin[k]]) {
+                in[Ckt.fanin[k]] = 1;
+                stack.push_back(Ckt.fanin[k]);
+            }
+    }
+    for(i = 0; i < Ntape; i++)
+        if(in[Tape[i].out]) cn.tape.push_back(Tape[i]);
+    for(i = 0; i < Npi; i++)
+        if(in[Pinput[i]->indx]) cn.pi.push_back(i);
+    VERB(1) printf("cone of %d PO%s: %d nodes, %d of %d gates, %d of %d PIs\n", (int) po.size(), po.size() > 1 ? "s" : "",
+                   cn.nnode, (int) cn.tape.size(), Ntape, (int) cn.pi.size(), Npi);
+    return &cn;
+}
+
+/*-----------------------------------------------------------------------
+input: output cone, words per node (per bit plane if three-valued),
+       three-valued flag, vector file name, output file name
+output: nothing
+called by: logicsim
+description:
+    LOGICSIM -O: simulates the vectors on the gates of the cone only and
+    writes the PO lines of the cone's POs, in the order of Poutput. The
+    vectors are read and simulated as in LOGICSIM -P (two-valued) or
+    LOGICSIM -X (three-valued), 64*nw of them per pass; only the node
+    values of the cone are left from the last vector.
+-----------------------------------------------------------------------*/
+static void logicsim_cone(const conestruc &cn, int nw, int x3, const string &infile, const string &outfile){
+    int i, p, npat, nvec = 0, np = x3 ? 2 : 1, ntape = cn.tape.size(), o, z;
+    size_t w;
+    vector<int> pival(Npi);
+    vector<uint64_t> piword, val((size_t) Nnodes * np * nw, 0);
+    tapefn kern = tapekern(nw, x3);
+    vecreader in;
+    vecwriter out;
+
+    if(in.open(infile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(out.open(outfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    for(i = 0; i < Npi; i++) pival[i] = Pinput[i]->value;
+    while((npat = x3 ? readblock3(in, pival, piword, nw) : readblock(in, pival, piword, nw)) > 0) {
+        for(size_t c = 0; c < cn.pi.size(); c++)
+            memcpy(&val[(size_t) Pinput[cn.pi[c]]->indx * np * nw], &piword[(size_t) cn.pi[c] * np * nw], np * nw * sizeof(uint64_t));
+        if(ntape) kern(&cn.tape[0], Tapefin, &val[0], 0, ntape);
+        Stats.gateevals += (long long) ntape * nw;
+        for(p = 0; p < npat; p++, nvec++) {
+            if(nvec > 0) out.put('\n');
+            for(size_t c = 0; c < cn.po.size(); c++) {
+                w = (size_t) Poutput[cn.po[c]]->indx * np * nw + p / 64;
+                o = (val[w] >> (p % 64)) & 1;
+                z = x3 ? (val[w + nw] >> (p % 64)) & 1 : !o;
+                out.poline(Poutput[cn.po[c]]->num, o ? 1 : z ? 0 : VALX);
+            }
+        }
+        //Leave the node values of the last vector in the cone
+        p = npat - 1;
+        for(i = 0; i < ntape; i++) {
+            w = (size_t) cn.tape[i].out * np * nw + p / 64;
+            o = (val[w] >> (p % 64)) & 1;
+            z = x3 ? (val[w + nw] >> (p % 64)) & 1 : !o;
+            Node[cn.tape[i].out].value = o ? 1 : z ? 0 : VALX;
+        }
+        for(size_t c = 0; c < cn.pi.size(); c++)
+            Pinput[cn.pi[c]]->value = x3 ? pival[cn.pi[c]] : pival[cn.pi[c]] > 0;
+    }
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    Stats.vectors += nvec;
+    printf("==> %d vectors simulated on %d of %d gates", nvec, ntape, Ntape);
+}
+
+/*======================Event-driven Logic Simulator======================*/
+/*-----------------------------------------------------------------------
+input: node index, value array indexed by node
+output: value word of the gate output
+called by: logicsim_event
+description:
+    Evaluates a single gate from the CSR fanin of node n. This is the
+    one-gate counterpart of a tapesim() op.
+-----------------------------------------------------------------------*/
+uint64_t evalnode(uint32_t n, const uint64_t *val){
+    const uint32_t *f = Ckt.fanin + Ckt.finoff[n], *fend = Ckt.fanin + Ckt.finoff[n + 1];
+    uint64_t r;
+
+    switch(Ckt.type[n]) {
+        case BRCH:
+        case BUFFER:
+            return val[*f];
+        case NOT:
+            return ~val[*f];
+        case OR:
+        case NOR:
+            for(r = 0; f < fend; f++) r |= val[*f];
+            return Ckt.type[n] == NOR ? ~r : r;
+        case AND:
+        case NAND:
+            for(r = ~(uint64_t)0; f < fend; f++) r &= val[*f];
+            return Ckt.type[n] == NAND ? ~r : r;
+        case XOR:
+        case XNOR:
+            for(r = 0; f < fend; f++) r ^= val[*f];
+            return Ckt.type[n] == XNOR ? ~r : r;
+        default:
+            return val[n];
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: node index, per-level event queues, queued flags
+output: nothing
+called by: logicsim_event
+description:
+    Schedules the down nodes of n into the queue of their level.
+-----------------------------------------------------------------------*/
+static void schedule(uint32_t n, vector< vector<uint32_t> > &evq, vector<char> &inq){
+    uint32_t k, d;
+
+    for(k = Ckt.foutoff[n]; k < Ckt.foutoff[n + 1]; k++) {
+        d = Ckt.fanout[k];
+        if(inq[d]) continue;
+        inq[d] = 1;
+        evq[Node[d].level].push_back(d);
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: vector file name, output file name
+output: nothing
+called by: logicsim
+description:
+    Event-driven simulation (LOGICSIM -E) for vector sets where consecutive
+    vectors differ in a few PIs. The first vector is simulated in full over
+    the tape. For every following vector only the PIs whose value changed
+    schedule their down nodes, into one queue per level; the levels are
+    then processed in order and a gate whose output does not change stops
+    the propagation. Each node value is kept as an all-0 or all-1 word in
+    Pvalue. The gate evaluations of each vector are reported next to the
+    number of tape ops a full levelized pass would take. The output file
+    has the same format as LOGICSIM -P.
+-----------------------------------------------------------------------*/
+void logicsim_event(const string &infile, const string &outfile){
+    int i, l, p, npat, nvec = 0;
+    uint32_t n;
+    uint64_t b, r;
+    long long nevals, total = 0;
+    size_t j;
+    vector<int> pival(Npi);
+    vector<uint64_t> piword;
+    vector< vector<uint32_t> > evq(Nlevels);
+    vector<char> inq(Nnodes, 0);
+    vecreader in;
+    vecwriter out;
+
+    if(in.open(infile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(out.open(outfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    for(i = 0; i < Npi; i++) pival[i] = Pinput[i]->value;
+    while((npat = readblock(in, pival, piword)) > 0) {
+        for(p = 0; p < npat; p++, nvec++) {
+            nevals = 0;
+            if(nvec == 0) {     //no previous state to compare with
+                for(i = 0; i < Npi; i++)
+                    Pvalue[Pinput[i]->indx] = (piword[i] >> p) & 1 ? ~(uint64_t)0 : 0;
+                tapesim(Pvalue);
+                nevals = Ntape;
+            }
+            for(i = 0; i < Npi && nvec > 0; i++) {
+                n = Pinput[i]->indx;
+                b = (piword[i] >> p) & 1 ? ~(uint64_t)0 : 0;
+                if(Pvalue[n] == b) continue;
+                Pvalue[n] = b;
+                schedule(n, evq, inq);
+            }
+            for(l = 1; l < Nlevels; l++) {
+                for(j = 0; j < evq[l].size(); j++) {
+                    n = evq[l][j];
+                    inq[n] = 0;
+                    r = evalnode(n, Pvalue);
+                    nevals++;
+                    if(r == Pvalue[n]) continue;
+                    Pvalue[n] = r;
+                    schedule(n, evq, inq);
+                }
+                evq[l].clear();
+            }
+            total += nevals;
+            if(nvec > 0) out.put('\n');
+            for(i = 0; i < Npo; i++)
+                out.poline(Poutput[i]->num, Pvalue[Poutput[i]->indx] & 1);
+            VERB(1) printf("vector %d: %lld gate evaluations (%.2f%% of %d)\n", nvec, nevals,
+                   Ntape ? 100.0 * nevals / Ntape : 0.0, Ntape);
+        }
+    }
+    for(i = 0; i < Nnodes; i++) Node[i].value = Pvalue[i] & 1;
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    if(nvec > 0) Stats.gateevals += total - Ntape;     //the first vector's tapesim() is already counted
+    Stats.vectors += nvec;
+    printf("==> %d vectors simulated, %lld gate evaluations, activity %.2f%% of levelized simulation",
+           nvec, total, nvec && Ntape ? 100.0 * total / ((double)nvec * Ntape) : 0.0);
+}
+
+/*=========================Timed Logic Simulator==========================*/
+/*-----------------------------------------------------------------------
+LOGICSIM -T simulates with gate delays, so it shows the hazards the
+zero-delay simulators cannot: a gate output may switch several times
+before it settles. Every gate type has a delay (1, branches 0; see
+readdelays()). An evaluation that changes the projected output of a
+gate schedules the transition delay time steps later on a timing wheel.
+The wheel is an array of time slots, one list of events each. It needs
+more slots than the largest delay, so every pending event is within
+one turn of it. A gate that is evaluated back to its current output
+while a transition is pending cancels it. This is the inertial delay
+model: pulses shorter than the gate delay do not get through. The
+events come from a pool that is reused from vector to vector.
+-----------------------------------------------------------------------*/
+static const uint32_t TNIL = 0xffffffffu;   /* no event */
+
+/* A scheduled output transition, linked into the slot of its time. */
+struct tevent {
+    uint32_t node;             /* node index */
+    uint32_t next;             /* next event of the slot or of the free list */
+    unsigned char val;         /* new output value */
+    unsigned char dead;        /* cancelled by the inertial filter */
+};
+
+struct twheel {
+    vector<tevent> pool;       /* all events, see add() and release() */
+    uint32_t freelist;
+    vector<uint32_t> slot;     /* first event of each time slot */
+    uint32_t mask;
+    long long queued;          /* events in the slots, cancelled ones included */
+
+    void init(int maxdelay){
+        uint32_t size = 1;
+
+        while(size <= (uint32_t) maxdelay) size <<= 1;
+        slot.assign(size, TNIL);
+        mask = size - 1;
+        freelist = TNIL;
+        queued = 0;
+    }
+    /* schedules node n to change to v at time t */
+    uint32_t add(long long t, uint32_t n, int v){
+        uint32_t e;
+
+        if(freelist != TNIL) {
+            e = freelist;
+            freelist = pool[e].next;
+        }
+        else {
+            e = pool.size();
+            pool.push_back(tevent());
+        }
+        pool[e].node = n;
+        pool[e].val = v;
+        pool[e].dead = 0;
+        pool[e].next = slot[t & mask];
+        slot[t & mask] = e;
+        queued++;
+        return e;
+    }
+    /* unlinks the events of time t, the list is walked by the caller */
+    uint32_t take(long long t){
+        uint32_t e = slot[t & mask];
+
+        slot[t & mask] = TNIL;
+        return e;
+    }
+    void release(uint32_t e){
+        pool[e].next = freelist;
+        freelist = e;
+        queued--;
+    }
+};
+
+/*-----------------------------------------------------------------------
+input: delay file name (empty for the defaults), delays to fill, largest
+       delay to fill
+output: 0 on success, -1 on failure
+called by: logicsim_timed
+description:
+    Sets the delay of every node: 0 for PIs and branches, 1 for the other
+    gates. Each line of the delay file is "gate delay", with the gate
+    type as PC prints it, or "num delay" for a single node; node lines
+    win over gate lines. Delays are 0 .. MAXDELAY time steps.
+-----------------------------------------------------------------------*/
+static int readdelays(const string &name, vector<uint32_t> &delay, int &maxdelay){
+    int typedelay[BUFFER + 1] = {0, 0, 1, 1, 1, 1, 1, 1, 1, 1};
+    vector< pair<int, int> > nodedelay;
+    const char *s, *e, *w;
+    vecreader in;
+    idmap ids;
+    string type;
+    int i, t, num, d;
+    size_t j;
+
+    if(!name.empty()) {
+        if(in.open(name.c_str()) < 0) {
+            cerr<<"ERROR! We cannot read the delay file "<<name<<endl;
+            return -1;
+        }
+        ids.init(Nnodes);
+        for(i = 0; i < Nnodes; i++) ids.insert(Node[i].num, i);
+        while(in.getline(s, e)) {
+            while(s < e && isspace(*s)) s++;
+            if(s == e) continue;
+            t = -1;
+            num = -1;
+            if(isalpha(*s)) {
+                for(w = s; s < e && !isspace(*s); s++) ;
+                for(type.assign(w, s), j = 0; j < type.size(); j++) type[j] = Upcase(type[j]);
+                for(t = BRCH; t <= BUFFER && gname(t) != type; t++) ;
+                if(t > BUFFER) {
+                    cerr<<"Error: line "<<in.nline<<": unknown gate type "<<type<<endl;
+                    return -1;
+                }
+            }
+            else if(!scanint(s, e, num)) num = -2;
+            if(num == -2 || !scanint(s, e, d) || d < 0 || d > MAXDELAY) {
+                cerr<<"Error: line "<<in.nline<<": malformed delay, expected gate or node and 0.."<<MAXDELAY<<endl;
+                return -1;
+            }
+            if(t >= 0) typedelay[t] = d;
+            else if((i = ids.find(num)) < 0) {
+                cerr<<"Error: line "<<in.nline<<": node "<<num<<" is not in the circuit"<<endl;
+                return -1;
+            }
+            else nodedelay.push_back(make_pair(i, d));
+        }
+    }
+    delay.resize(Nnodes);
+    for(i = 0; i < Nnodes; i++) delay[i] = Node[i].type == IPT ? 0 : typedelay[Node[i].type];
+    for(j = 0; j < nodedelay.size(); j++) delay[nodedelay[j].first] = nodedelay[j].second;
+    for(maxdelay = 0, i = 0; i < Nnodes; i++) maxdelay = max(maxdelay, (int) delay[i]);
+    return 0;
+}
+
+/* Per-node state of the timed simulator, together for locality. */
+struct tnode {
+    uint32_t pend;             /* pending event, TNIL if none */
+    uint32_t ntrans;           /* transitions in this vector */
+    uint32_t mark;             /* stamp of the slot it was last queued in */
+    uint16_t delay;            /* gate delay */
+    unsigned char proj;        /* value once the pending event is applied */
+    unsigned char init;        /* value at the start of the vector */
+};
+
+/* evalnode() on one byte per node */
+static inline int evaltimed(uint32_t n, const unsigned char *v){
+    const uint32_t *f = Ckt.fanin + Ckt.finoff[n], *fend = Ckt.fanin + Ckt.finoff[n + 1];
+    int r;
+
+    switch(Ckt.type[n]) {
+        case BRCH:
+        case BUFFER:
+            return v[*f];
+        case NOT:
+            return !v[*f];
+        case OR:
+        case NOR:
+            for(r = 0; f < fend; f++) r |= v[*f];
+            return Ckt.type[n] == NOR ? !r : r;
+        case AND:
+        case NAND:
+            for(r = 1; f < fend; f++) r &= v[*f];
+            return Ckt.type[n] == NAND ? !r : r;
+        case XOR:
+        case XNOR:
+            for(r = 0; f < fend; f++) r ^= v[*f];
+            return Ckt.type[n] == XNOR ? !r : r;
+        default:
+            return v[n];
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: delay file name (may be empty), vector file name, output file
+       name, transition file name
+output: nothing
+called by: logicsim
+description:
+    Timed simulation (LOGICSIM -T). Like LOGICSIM -E, the first vector
+    is simulated in full and sets the initial state. Every following
+    vector changes its PIs at time 0 and runs until the wheel is empty.
+    Each time slot applies its events first and then evaluates every
+    gate they reach once. A zero delay schedules into the slot being
+    processed, which is run again. Node values are one byte each and the
+    per-node state is one tnode, so the random accesses of the events
+    stay in few cache lines. The output file is the one of LOGICSIM -E,
+    with the settled values. For every vector the transition file has a
+    "num,transitions,glitches" line per node that switched, in file
+    order; glitches counts the transitions beyond the single one of a
+    node whose value changed.
+-----------------------------------------------------------------------*/
+void logicsim_timed(const string &delayfile, const string &infile, const string &outfile, const string &trfile){
+    int i, p, npat, nvec = 0, maxdelay = 0, glitch, b;
+    uint32_t n, e, next, k, d, stamp = 0;
+    long long t, settle, maxsettle = 0, ntr, nglitch, nfilt, ntotal = 0, gtotal = 0, ftotal = 0, nevals = 0;
+    size_t j;
+    double t0 = seconds();
+    vector<uint32_t> delay, touched, evl, pos(Nnodes);
+    vector<tnode> tn(Nnodes);
+    vector<unsigned char> val(Nnodes);
+    vector<int> pival(Npi);
+    vector<uint64_t> piword;
+    twheel w;
+    vecreader in;
+    vecwriter out, tr;
+
+    if(readdelays(delayfile, delay, maxdelay) < 0) return;
+    if(in.open(infile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(out.open(outfile.c_str()) < 0 || tr.open(trfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    for(i = 0; i < Nnodes; i++) {
+        tn[i].pend = TNIL;
+        tn[i].ntrans = tn[i].mark = 0;
+        tn[i].delay = delay[i];
+        pos[FILEIDX(i)] = i;
+    }
+    w.init(maxdelay);
+    for(i = 0; i < Npi; i++) pival[i] = Pinput[i]->value;
+    while((npat = readblock(in, pival, piword)) > 0) {
+        for(p = 0; p < npat; p++, nvec++) {
+            settle = ntr = nglitch = nfilt = 0;
+            if(nvec == 0) {     //the initial state, no transitions
+                for(i = 0; i < Npi; i++)
+                    Pvalue[Pinput[i]->indx] = (piword[i] >> p) & 1 ? ~(uint64_t)0 : 0;
+                tapesim(Pvalue);
+                for(i = 0; i < Nnodes; i++) val[i] = Pvalue[i] & 1;
+            }
+            for(i = 0; i < Npi && nvec > 0; i++) {
+                n = Pinput[i]->indx;
+                b = (piword[i] >> p) & 1;
+                if(val[n] == b) continue;
+                tn[n].pend = w.add(0, n, b);
+                tn[n].proj = b;
+            }
+            for(t = 0; w.queued; t++) {
+                while((e = w.take(t)) != TNIL) {
+                    if(++stamp == 0) {
+                        for(i = 0; i < Nnodes; i++) tn[i].mark = 0;
+                        stamp = 1;
+                    }
+                    for(; e != TNIL; e = next) {
+                        next = w.pool[e].next;
+                        if(!w.pool[e].dead) {
+                            n = w.pool[e].node;
+                            tn[n].pend = TNIL;
+                            if(tn[n].ntrans++ == 0) {
+                                touched.push_back(n);
+                                tn[n].init = val[n];
+                            }
+                            val[n] = w.pool[e].val;
+                            ntr++;
+                            settle = t;
+                            for(k = Ckt.foutoff[n]; k < Ckt.foutoff[n + 1]; k++) {
+                                d = Ckt.fanout[k];
+                                if(tn[d].mark == stamp) continue;
+                                tn[d].mark = stamp;
+                                evl.push_back(d);
+                            }
+                        }
+                        w.release(e);
+                    }
+                    for(j = 0; j < evl.size(); j++) {
+                        n = evl[j];
+                        b = evaltimed(n, &val[0]);
+                        nevals++;
+                        if(b == (tn[n].pend != TNIL ? tn[n].proj : val[n])) continue;
+                        if(tn[n].pend != TNIL) {        //back to the current value: a pulse too short
+                            w.pool[tn[n].pend].dead = 1;
+                            tn[n].pend = TNIL;
+                            nfilt++;
+                        }
+                        else {
+                            tn[n].pend = w.add(t + tn[n].delay, n, b);
+                            tn[n].proj = b;
+                        }
+                    }
+                    evl.clear();
+                }
+            }
+
+            if(nvec > 0) {
+                out.put('\n');
+                tr.put('\n');
+            }
+            for(i = 0; i < Npo; i++)
+                out.poline(Poutput[i]->num, val[Poutput[i]->indx]);
+            if(touched.size() * 8 < (size_t) Nnodes) {     //few nodes switched: sort them into file order
+                for(j = 0; j < touched.size(); j++) touched[j] = pos[touched[j]];
+                sort(touched.begin(), touched.end());
+            }
+            else {
+                touched.clear();
+                for(i = 0; i < Nnodes; i++)
+                    if(tn[FILEIDX(i)].ntrans) touched.push_back(i);
+            }
+            for(j = 0; j < touched.size(); j++) {
+                n = FILEIDX(touched[j]);
+                glitch = tn[n].ntrans - (tn[n].init != val[n]);
+                nglitch += glitch;
+                tr.putint(Node[n].num);
+                tr.put(',');
+                tr.putint(tn[n].ntrans);
+                tr.put(',');
+                tr.putint(glitch);
+                tr.put('\n');
+                tn[n].ntrans = 0;
+            }
+            touched.clear();
+            ntotal += ntr;
+            gtotal += nglitch;
+            ftotal += nfilt;
+            if(settle > maxsettle) maxsettle = settle;
+            VERB(1) printf("vector %d: %lld transitions, %lld glitches, %lld pulses filtered, settled at t=%lld\n",
+                   nvec, ntr, nglitch, nfilt, settle);
+        }
+    }
+    for(i = 0; i < Nnodes; i++) {
+        Node[i].value = val[i];
+        Pvalue[i] = val[i] ? ~(uint64_t)0 : 0;
+    }
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    if(tr.close() < 0) {
+        cerr<<"Error: cannot write "<<trfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    Stats.gateevals += nevals;
+    Stats.vectors += nvec;
+    printf("==> %d vectors simulated, %lld transitions, %lld glitches (%.2f%%), %lld pulses filtered, "
+           "settled by t=%lld, %lld gate evaluations, %.0f events/s",
+           nvec, ntotal, gtotal, ntotal ? 100.0 * gtotal / ntotal : 0.0, ftotal, maxsettle, nevals,
+           (ntotal + ftotal) / max(seconds() - t0, 1e-9));
+}
+
+/*=======================Sharded Logic Simulator==========================*/
+/*-----------------------------------------------------------------------
+A shard of the vector file for LOGICSIM -S: a run of whole vectors, the
+PI values in force before its first vector and, once simulated, the PO
+lines of its vectors.
+-----------------------------------------------------------------------*/
+struct shard {
+    const char *s, *e;              /* text of the shard */
+    int line0;                      /* lines of the file before the shard */
+    std::vector<signed char> last;  /* last value given to each PI, -1 if none */
+    std::vector<int> start;         /* PI values before the first vector */
+    std::string out;                /* PO lines of the shard */
+    long long nvec, evals;
+    int worker;                     /* thread that simulated the shard */
+    int npat;                       /* vectors in its last block */
+    int done;
+};
+
+void simstate::init(int words){
+    nw = words;
+    val.assign((size_t) Nnodes * nw, 0);
+    pival.assign(Npi, 0);
+    piword.clear();
+    evals = nvec = 0;
+}
+
+/* start of the first vector that begins at or after p */
+static const char *vecboundary(const char *p, const char *e){
+    const char *q;
+    int blank;
+
+    while(p < e && p[-1] != '\n') p++;
+    while(p < e) {
+        for(q = p, blank = 1; q < e && *q != '\n'; q++)
+            if(!isspace(*q)) blank = 0;
+        p = q < e ? q + 1 : e;
+        if(blank) return p;
+    }
+    return e;
+}
+
+/* last value given to each PI in [s, e), scanning backwards until every
+   PI is seen; malformed lines are left to the forward pass to report */
+static void lastvalues(const char *s, const char *e, vector<signed char> &last){
+    const char *ls, *le = e, *p;
+    int nseen = 0, id, v;
+
+    last.assign(Npi, -1);
+    while(le > s && nseen < Npi) {
+        for(ls = le; ls > s && ls[-1] != '\n'; ls--) ;
+        p = ls;
+        if(scanint(p, le, id, ",") && p < le && *p++ == ',' && scanvalue(p, le, v) &&
+           id >= 0 && id < Npislot && Pislot[id] >= 0 && last[Pislot[id]] < 0) {
+            last[Pislot[id]] = v > 0;
+            nseen++;
+        }
+        le = ls > s ? ls - 1 : s;
+    }
+}
+
+/* appends the "num,value" line of a PO */
+static void putpo(std::string &o, unsigned num, int value){
+    char tmp[16];
+    int n = 0;
+
+    do tmp[n++] = '0' + num % 10; while(num /= 10);
+    while(n) o += tmp[--n];
+    o += ',';
+    o += '0' + value;
+    o += '\n';
+}
+
+/* simulates one shard on the state of a worker thread */
+static void simshard(shard &sh, simstate &st){
+    tapefn fn = tapekern(st.nw);
+    vecreader in;
+    int i, p, npat;
+
+    in.openmem(sh.s, sh.e, sh.line0);
+    st.pival = sh.start;
+    while((npat = readblock(in, st.pival, st.piword, st.nw)) > 0) {
+        for(i = 0; i < Npi; i++)
+            memcpy(&st.val[(size_t) Pinput[i]->indx * st.nw], &st.piword[(size_t) i * st.nw], st.nw * sizeof(uint64_t));
+        if(!Native || Native(&st.val[0], st.nw) < 0) fn(Tape, Tapefin, &st.val[0], 0, Ntape);
+        st.evals += (long long) Ntape * st.nw;
+        sh.evals += (long long) Ntape * st.nw;
+        for(p = 0; p < npat; p++) {
+            if(sh.nvec++ > 0) sh.out += '\n';
+            for(i = 0; i < Npo; i++) putpo(sh.out, Poutput[i]->num, st.bit(Poutput[i]->indx, p));
+        }
+        sh.npat = npat;
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: vector file name, output file name
+output: nothing
+called by: logicsim
+description:
+    Sharded pattern-parallel logic simulation (LOGICSIM -S) on Nthreads
+    threads. The memory mapped vector file is cut at vector boundaries
+    into shards, several per thread. A vector inherits the PIs it does
+    not list from the one before, so the threads first find the last
+    value of every PI in each shard by scanning it backwards, which for
+    complete vectors stops after one vector, and the PI values before
+    every shard follow in one sequential sweep. The threads then take
+    the shards in order and simulate them a kernel block per pass, each
+    with its own simstate over the shared tape, while this thread writes
+    the PO lines of the finished shards in input order. The output is
+    the one of LOGICSIM -P.
+-----------------------------------------------------------------------*/
+void logicsim_shard(const string &infile, const string &outfile){
+    int fd, w, nthr = Nthreads, i, nw = simdwords();
+    size_t c, nsh, len, shsize;
+    struct stat st;
+    const char *data = NULL, *p, *q;
+    vecwriter out;
+    long long nvec = 0, evals = 0;
+
+    if((fd = open(infile.c_str(), O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        if(fd >= 0) close(fd);
+        return;
+    }
+    len = st.st_size;
+    if(len > 0 && (data = (const char *) mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        close(fd);
+        return;
+    }
+    close(fd);
+    if(out.open(outfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        if(len > 0) munmap((void *) data, len);
+        return;
+    }
+    Stats.bytes += len;
+
+    /* shards of about len / (8 * threads) bytes, at least 64KB */
+    shsize = std::max((size_t) 1 << 16, len / (8 * nthr) + 1);
+    vector<shard> sh;
+    for(p = data; p < data + len; p = q) {
+        q = p + shsize < data + len ? vecboundary(p + shsize, data + len) : data + len;
+        sh.resize(sh.size() + 1);
+        sh.back().s = p;
+        sh.back().e = q;
+        sh.back().nvec = sh.back().evals = 0;
+        sh.back().npat = sh.back().done = 0;
+    }
+    nsh = sh.size();
+
+    /* pass 1: last PI values and line count of every shard */
+    std::atomic<size_t> next(0);
+    vector<std::thread> thr;
+    for(w = 0; w < nthr; w++)
+        thr.push_back(std::thread([&]{
+            size_t k;
+            while((k = next.fetch_add(1)) < nsh) {
+                lastvalues(sh[k].s, sh[k].e, sh[k].last);
+                sh[k].line0 = std::count(sh[k].s, sh[k].e, '\n');
+            }
+        }));
+    for(w = 0; w < nthr; w++) thr[w].join();
+    thr.clear();
+    vector<int> pival(Npi);
+    int line0 = 0, n;
+    for(i = 0; i < Npi; i++) pival[i] = Pinput[i]->value;
+    for(c = 0; c < nsh; c++) {
+        sh[c].start = pival;
+        for(i = 0; i < Npi; i++)
+            if(sh[c].last[i] >= 0) pival[i] = sh[c].last[i];
+        n = sh[c].line0;
+        sh[c].line0 = line0;
+        line0 += n;
+    }
+
+    /* pass 2: simulate, at most 4 shards per thread ahead of the writer */
+    vector<simstate> state(nthr);
+    std::mutex m;
+    std::condition_variable cv;
+    size_t written = 0;
+    next = 0;
+    for(w = 0; w < nthr; w++)
+        thr.push_back(std::thread([&](int w){
+            size_t k;
+            state[w].init(nw);
+            while((k = next.fetch_add(1)) < nsh) {
+                {
+                    std::unique_lock<std::mutex> lk(m);
+                    while(k >= written + 4 * nthr) cv.wait(lk);
+                }
+                simshard(sh[k], state[w]);
+                sh[k].worker = w;
+                std::lock_guard<std::mutex> lk(m);
+                sh[k].done = 1;
+                cv.notify_all();
+            }
+        }, w));
+    int lastsh = -1;
+    for(c = 0; c < nsh; c++) {
+        {
+            std::unique_lock<std::mutex> lk(m);
+            while(!sh[c].done) cv.wait(lk);
+        }
+        if(sh[c].nvec > 0) {
+            if(nvec > 0) out.put('\n');
+            out.write(sh[c].out.data(), sh[c].out.size());
+            lastsh = c;
+        }
+        nvec += sh[c].nvec;
+        evals += sh[c].evals;
+        std::string().swap(sh[c].out);
+        std::lock_guard<std::mutex> lk(m);
+        written = c + 1;
+        cv.notify_all();
+    }
+    for(w = 0; w < nthr; w++) thr[w].join();
+    if(len > 0) munmap((void *) data, len);
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+
+    //Leave the node values of the last vector, as the serial simulator does
+    if(lastsh >= 0) {
+        const simstate &last = state[sh[lastsh].worker];
+        for(i = 0; i < Nnodes; i++) Node[i].value = last.bit(i, sh[lastsh].npat - 1);
+    }
+    Stats.gateevals += evals;
+    Stats.vectors += nvec;
+    printf("==> %lld vectors simulated on %d thread%s", nvec, nthr, nthr > 1 ? "s" : "");
+}
+
+/*=========================MISR Response Compaction=======================*/
+/*-----------------------------------------------------------------------
+LOGICSIM -M folds the PO values of every vector into a 64-bit multiple
+input signature register instead of writing them out. The register
+shifts once per vector with the feedback polynomial MISRPOLY, x^64 +
+x^4 + x^3 + x + 1, and takes PO i into bit i mod 64. Besides the
+signature of the whole run, every window of a given number of vectors
+gets a signature of its own, from a register cleared at its start, so a
+mismatch against a golden run points at the windows to look at, and
+LOGICSIM -W re-simulates just one of them with the full PO lines.
+-----------------------------------------------------------------------*/
+#define MISRPOLY 0x1bULL
+
+/* transposes the 64x64 bit matrix a: bit j of a[i] goes to bit i of a[j] */
+static void transpose64(uint64_t *a){
+    uint64_t m = 0x00000000ffffffffULL, t;
+    int j, k;
+
+    for(j = 32; j != 0; j >>= 1, m ^= m << j)
+        for(k = 0; k < 64; k = (k + j + 1) & ~j) {
+            t = ((a[k] >> j) ^ a[k + j]) & m;
+            a[k + j] ^= t;
+            a[k] ^= t << j;
+        }
+}
+
+/* signature registers of a LOGICSIM -M run */
+struct misrstruc {
+    uint64_t all, win;         /* signatures of the run and of the current window */
+    long long nvec;            /* vectors clocked in */
+    long long window;          /* vectors per window, 0 for none */
+    FILE *fp;                  /* window signatures, NULL to drop them */
+    std::vector<uint64_t> sig; /* window signatures */
+
+    void clock(uint64_t in){
+        all = (all << 1 ^ (all >> 63) * MISRPOLY) ^ in;
+        win = (win << 1 ^ (win >> 63) * MISRPOLY) ^ in;
+        nvec++;
+        if(window && nvec % window == 0) endwindow();
+    }
+    void endwindow(){
+        long long w = (nvec - 1) / window;
+
+        sig.push_back(win);
+        if(fp) fprintf(fp, "%lld %lld %lld %016llx\n", w, w * window, nvec - w * window, (unsigned long long) win);
+        win = 0;
+    }
+};
+
+/* clocks the first npat vectors of the simulated block st into r */
+static void misrblock(const simstate &st, int npat, misrstruc &r){
+    uint64_t in[64], m[64];
+    int i, j, k, p;
+
+    for(k = 0; k * 64 < npat; k++) {
+        memset(in, 0, sizeof(in));
+        for(i = 0; i < Npo; i += 64) {
+            for(j = 0; j < 64; j++)
+                m[j] = i + j < Npo ? st.val[(size_t) Poutput[i + j]->indx * st.nw + k] : 0;
+            transpose64(m);
+            for(j = 0; j < 64; j++) in[j] ^= m[j];
+        }
+        for(p = 0; p < 64 && k * 64 + p < npat; p++) r.clock(in[p]);
+    }
+}
+
+/* reads the window size, the window signatures and the ALL line of a
+   signature file into g; -1 if it is not a complete one */
+static int readmisr(const char *name, misrstruc &g){
+    char line[MAXLINE];
+    unsigned long long poly, s;
+    long long w, first, n;
+    int all = 0;
+    FILE *fp;
+
+    if((fp = fopen(name, "r")) == NULL) return -1;
+    if(!fgets(line, sizeof(line), fp) || sscanf(line, "MISR %llx window %lld", &poly, &g.window) != 2 || poly != MISRPOLY) {
+        fclose(fp);
+        return -1;
+    }
+    g.sig.clear();
+    while(fgets(line, sizeof(line), fp)) {
+        if(sscanf(line, "ALL %lld %llx", &n, &s) == 2) {
+            g.nvec = n;
+            g.all = s;
+            all = 1;
+        }
+        else if(sscanf(line, "%lld %lld %lld %llx", &w, &first, &n, &s) == 4 && w == (long long) g.sig.size()) g.sig.push_back(s);
+    }
+    fclose(fp);
+    return all ? 0 : -1;
+}
+
+/*-----------------------------------------------------------------------
+input: vectors per window (0 for none), vector file name, signature file
+       name, golden signature file name or empty
+output: nothing
+called by: logicsim
+description:
+    LOGICSIM -M: pattern-parallel simulation as with -P, the PO values
+    compacted into signatures (see above). The signature file has the
+    header "MISR <poly> window <n>", a "<window> <first vector>
+    <vectors> <signature>" line per window and "ALL <vectors>
+    <signature>" at the end. With a golden file of the same window size
+    a different vector count or signature of the run is reported, and so
+    are the windows whose signatures differ.
+-----------------------------------------------------------------------*/
+void logicsim_misr(long long window, const string &infile, const string &sigfile, const string &golden){
+    simstate st;
+    vecreader in;
+    misrstruc r, g;
+    size_t w, nbad = 0;
+    int i, npat;
+
+    if(!golden.empty() && (readmisr(golden.c_str(), g) < 0 || g.window != window)) {
+        printf("Error: %s is not a signature file of windows of %lld vectors\n", golden.c_str(), window);
+        return;
+    }
+    if(in.open(infile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if((r.fp = fopen(sigfile.c_str(), "w")) == NULL) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    r.all = r.win = 0;
+    r.nvec = 0;
+    r.window = window;
+    fprintf(r.fp, "MISR %llx window %lld\n", (unsigned long long) MISRPOLY, window);
+    st.init(simdwords());
+    for(i = 0; i < Npi; i++) st.pival[i] = Pinput[i]->value;
+    while((npat = readblock(in, st.pival, st.piword, st.nw)) > 0) {
+        for(i = 0; i < Npi; i++)
+            memcpy(&st.val[(size_t) Pinput[i]->indx * st.nw], &st.piword[(size_t) i * st.nw], st.nw * sizeof(uint64_t));
+        tapesimw(&st.val[0], st.nw);
+        misrblock(st, npat, r);
+    }
+    if(window && r.nvec % window) r.endwindow();
+    fprintf(r.fp, "ALL %lld %016llx\n", r.nvec, (unsigned long long) r.all);
+    fclose(r.fp);
+    Stats.vectors += r.nvec;
+    printf("==> %lld vectors, %d window%s, signature %016llx", r.nvec, (int) r.sig.size(), r.sig.size() == 1 ? "" : "s",
+           (unsigned long long) r.all);
+    if(golden.empty()) return;
+    if(r.nvec != g.nvec || r.all != g.all)
+        printf("\n==> mismatch: %s has %lld vectors, signature %016llx", golden.c_str(), g.nvec,
+               (unsigned long long) g.all);
+    for(w = 0; w < r.sig.size() || w < g.sig.size(); w++)
+        if(w >= r.sig.size() || w >= g.sig.size() || r.sig[w] != g.sig[w]) {
+            if(nbad++ == 0) printf("\n==> mismatching windows (see LOGICSIM -W):");
+            if(nbad <= 20) printf(" %d", (int) w);
+        }
+    if(nbad > 20) printf(" ... (%d in all)", (int) nbad);
+    if(nbad == 0 && r.nvec == g.nvec && r.all == g.all)
+        printf("\n==> %s matches%s", golden.c_str(), window ? ", all windows" : "");
+}
+
+/*-----------------------------------------------------------------------
+input: window number, signature file name, vector file name, output
+       file name
+output: nothing
+called by: logicsim
+description:
+    LOGICSIM -W: simulates only the vectors of one window of a LOGICSIM
+    -M run, whose size is read from its signature file, and writes their
+    PO lines as LOGICSIM -P does. The vectors before the window are only
+    parsed, for the PI values they pass on.
+-----------------------------------------------------------------------*/
+void logicsim_window(long long w, const string &sigfile, const string &infile, const string &outfile){
+    simstate st;
+    vecreader in;
+    vecwriter out;
+    misrstruc g;
+    long long window, skip, left, nvec = 0;
+    int i, p, npat;
+
+    if(readmisr(sigfile.c_str(), g) < 0 || (window = g.window) <= 0) {
+        printf("Error: %s is not a signature file with windows\n", sigfile.c_str());
+        return;
+    }
+    if(w < 0 || w >= (long long) g.sig.size()) {
+        printf("Error: %s has no window %lld\n", sigfile.c_str(), w);
+        return;
+    }
+    if(in.open(infile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(out.open(outfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    st.init(simdwords());
+    for(i = 0; i < Npi; i++) st.pival[i] = Pinput[i]->value;
+    for(skip = w * window; skip > 0 && in.next(st.pival); skip--) ;
+    for(left = window; left > 0 && (npat = readblock(in, st.pival, st.piword, st.nw)) > 0; left -= npat) {
+        if(npat > left) npat = left;        //the block may run past the window
+        for(i = 0; i < Npi; i++)
+            memcpy(&st.val[(size_t) Pinput[i]->indx * st.nw], &st.piword[(size_t) i * st.nw], st.nw * sizeof(uint64_t));
+        tapesimw(&st.val[0], st.nw);
+        for(p = 0; p < npat; p++, nvec++) {
+            if(nvec > 0) out.put('\n');
+            for(i = 0; i < Npo; i++)
+                out.poline(Poutput[i]->num, st.bit(Poutput[i]->indx, p));
+        }
+    }
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    Stats.vectors += nvec;
+    printf("==> window %lld: vectors %lld to %lld simulated", w, w * window, w * window + nvec - 1);
+}
+
+//Final function we want: logicsim()
+void logicsim(){
+    phasetimer timer(PH_LOGICSIM);
+    stringstream st(cp);
+    string inputfile, outputfile, polist;
+    st>>inputfile;
+    if(Tapelev == NULL && compile() < 0) return;
+    if(!Nativedir.empty() && Native == NULL) loadnative(0);
+    if(inputfile == "-O" || inputfile == "-o") {
+        conestruc *cn;
+        int x3 = 0, nw = 1;
+        st>>polist;
+        if((cn = findcone(polist)) == NULL) return;
+        st>>inputfile;
+        if(inputfile == "-P" || inputfile == "-p" || inputfile == "-X" || inputfile == "-x") {
+            x3 = Upcase(inputfile[1]) == 'X';
+            nw = simdwords();
+            st>>inputfile;
+        }
+        else if(inputfile[0] == '-') {
+            printf("Error: %s cannot be combined with -O\n", inputfile.c_str());
+            return;
+        }
+        st>>outputfile;
+        logicsim_cone(*cn, nw, x3, inputfile, outputfile);
+        return;
+    }
+    if(inputfile == "-M" || inputfile == "-m") {
+        long long window = -1;
+        string golden;
+        st>>window>>inputfile>>outputfile>>golden;
+        if(window < 0 || outputfile.empty()) {
+            printf("Error: LOGICSIM -M window infile sigfile [goldensig]\n");
+            return;
+        }
+        logicsim_misr(window, inputfile, outputfile, golden);
+        return;
+    }
+    if(inputfile == "-W" || inputfile == "-w") {
+        long long w = -1;
+        string sigfile;
+        st>>w>>sigfile>>inputfile>>outputfile;
+        if(w < 0 || outputfile.empty()) {
+            printf("Error: LOGICSIM -W window sigfile infile outfile\n");
+            return;
+        }
+        logicsim_window(w, sigfile, inputfile, outputfile);
+        return;
+    }
+    if(inputfile == "-P" || inputfile == "-p") {
+        st>>inputfile;
+        st>>outputfile;
+        logicsim_parallel(inputfile, outputfile);
+        return;
+    }
+    if(inputfile == "-X" || inputfile == "-x") {
+        st>>inputfile;
+        st>>outputfile;
+        logicsim3(inputfile, outputfile);
+        return;
+    }
+    if(inputfile == "-S" || inputfile == "-s") {
+        st>>inputfile;
+        st>>outputfile;
+        logicsim_shard(inputfile, outputfile);
+        return;
+    }
+    if(inputfile == "-T" || inputfile == "-t") {
+        string delayfile, trfile;
+        st>>inputfile;
+        if(inputfile == "-D" || inputfile == "-d") st>>delayfile>>inputfile;
+        st>>outputfile>>trfile;
+        if(trfile.empty()) {
+            printf("Error: LOGICSIM -T [-D delayfile] infile outfile trfile\n");
+            return;
+        }
+        logicsim_timed(delayfile, inputfile, outputfile, trfile);
+        return;
+    }
+    if(inputfile == "-E" || inputfile == "-e") {
+        st>>inputfile;
+        st>>outputfile;
+        logicsim_event(inputfile, outputfile);
+        return;
+    }
+    st>>outputfile;
+    inputFilename=inputfile;
+    outputFilename=outputfile;
+    if(Vin.open(inputFilename.c_str()) < 0){
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(Vout.open(outputFilename.c_str()) < 0){
+        cerr<<"Cannot open a output file to write"<<endl;
+        Vin.close();
+        return;
+    }
+    //Stream the vectors one at a time through the simulator
+    int nvec=0;
+    Vpival.resize(Npi);
+    for(int i=0;i<Npi;i++) Vpival[i]=Pinput[i]->value;
+    while(readfile()){
+        circuit_value_calculation();
+        outfilewriting(nvec++);
+    }
+    Vin.close();
+    if(Vout.close() < 0) {
+        cerr<<"Error: cannot write "<<outputFilename<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    Stats.vectors += nvec;
+    printf("==> %d vectors simulated", nvec);
+}
+/*=======================Random Pattern Simulator=========================*/
+/*-----------------------------------------------------------------------
+RANDSIM simulates pseudo-random patterns made on the fly and counts, for
+every node, the patterns where it is 1 and the toggles between
+consecutive patterns, one popcount per value word. Every group of 64
+patterns gets the words of its PIs from an xorshift64 generator (a
+linear feedback shift register of 64 bits, maximal period) seeded from
+the seed and the group number, so the patterns and the counts do not
+depend on SIMD or THREADS.
+-----------------------------------------------------------------------*/
+static inline uint64_t lfsr64(uint64_t &s){
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+}
+
+/* LFSR state of pattern group g, never 0 */
+static uint64_t lfsrseed(uint64_t seed, uint64_t g){
+    uint64_t z = seed + (g + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31)) | 1;
+}
+
+/* Adds the ones and the toggles of the patterns selected by mask (NW
+   words) to the counts of the nodes idx[0 .. nidx-1], kept by position
+   in idx. last holds the last value of each node in the pass before,
+   which the first pattern toggles from; in the first pass (first != 0)
+   that pattern does not toggle. */
+template<int NW> static inline __attribute__((always_inline))
+void countkernel(const uint64_t *val, const uint32_t *idx, int nidx, const uint64_t *mask, int first,
+                 uint64_t *ones, uint64_t *togg, unsigned char *last){
+    const uint64_t *v;
+    uint64_t c, o, t;
+    int j, k;
+
+    for(j = 0; j < nidx; j++) {
+        v = val + (size_t) idx[j] * NW;
+        c = first ? v[0] & 1 : last[j];
+        for(o = t = 0, k = 0; k < NW; k++) {
+            o += __builtin_popcountll(v[k] & mask[k]);
+            t += __builtin_popcountll((v[k] ^ (v[k] << 1 | c)) & mask[k]);
+            c = v[k] >> 63;
+        }
+        ones[j] += o;
+        togg[j] += t;
+        last[j] = c;
+    }
+}
+
+typedef void (*countfn)(const uint64_t *val, const uint32_t *idx, int nidx, const uint64_t *mask, int first,
+                        uint64_t *ones, uint64_t *togg, unsigned char *last);
+
+static void count64(const uint64_t *val, const uint32_t *idx, int nidx, const uint64_t *mask, int first,
+                    uint64_t *ones, uint64_t *togg, unsigned char *last){
+    countkernel<1>(val, idx, nidx, mask, first, ones, togg, last);
+}
+
+#ifdef SIMDX86
+__attribute__((target("popcnt")))
+static void count64p(const uint64_t *val, const uint32_t *idx, int nidx, const uint64_t *mask, int first,
+                     uint64_t *ones, uint64_t *togg, unsigned char *last){
+    countkernel<1>(val, idx, nidx, mask, first, ones, togg, last);
+}
+
+__attribute__((target("popcnt")))
+static void count256(const uint64_t *val, const uint32_t *idx, int nidx, const uint64_t *mask, int first,
+                     uint64_t *ones, uint64_t *togg, unsigned char *last){
+    countkernel<4>(val, idx, nidx, mask, first, ones, togg, last);
+}
+
+/* countkernel<8>() with the popcounts of AVX512-VPOPCNTDQ: the 8 words
+   of a node side by side, ones in the low and toggles in the high half
+   of every word, summed across the words at the end */
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void count512v(const uint64_t *val, const uint32_t *idx, int nidx, const uint64_t *mask, int first,
+                      uint64_t *ones, uint64_t *togg, unsigned char *last){
+    const v8u64 rot = {7, 0, 1, 2, 3, 4, 5, 6}, half = {4, 5, 6, 7, 0, 1, 2, 3};
+    const v8u64 quarter = {2, 3, 0, 1, 6, 7, 4, 5}, pair = {1, 0, 3, 2, 5, 4, 7, 6};
+    v8u64 v, m, p, u;
+    int j;
+
+    ldblk(m, mask);
+    for(j = 0; j < nidx; j++) {
+        ldblk(v, val + (size_t) idx[j] * 8);
+        p = __builtin_shuffle(v, rot) >> 63;
+        p[0] = first ? v[0] & 1 : last[j];
+        u = (v8u64) _mm512_popcnt_epi64((__m512i) (v & m)) +
+            ((v8u64) _mm512_popcnt_epi64((__m512i) ((v ^ (v << 1 | p)) & m)) << 32);
+        u += __builtin_shuffle(u, half);
+        u += __builtin_shuffle(u, quarter);
+        u += __builtin_shuffle(u, pair);
+        ones[j] += u[0] & 0xffffffff;
+        togg[j] += u[0] >> 32;
+        last[j] = v[7] >> 63;
+    }
+}
+
+__attribute__((target("popcnt")))
+static void count512(const uint64_t *val, const uint32_t *idx, int nidx, const uint64_t *mask, int first,
+                     uint64_t *ones, uint64_t *togg, unsigned char *last){
+    countkernel<8>(val, idx, nidx, mask, first, ones, togg, last);
+}
+#endif
+
+/* counting kernel of nw words per node */
+static countfn countkern(int nw){
+#ifdef SIMDX86
+    __builtin_cpu_init();
+    if(nw == 8 && __builtin_cpu_supports("avx512vpopcntdq")) return count512v;
+    if(__builtin_cpu_supports("popcnt")) return nw == 8 ? count512 : nw == 4 ? count256 : count64p;
+#endif
+    return count64;
+}
+
+/* counts of one worker thread over its passes, by position in the node
+   order of randsim() */
+struct randstruc {
+    simstate st;
+    vector<uint64_t> ones, togg;
+    vector<unsigned char> first, last;     /* node values of its first and last pattern */
+    uint64_t pass0, pass1;                  /* its passes [pass0, pass1) */
+};
+
+/* simulates the passes of one worker thread; order lists the nodes the
+   tape does not write, nrest of them, then the outputs of the tape ops */
+static void randpasses(randstruc &r, const vector<uint32_t> &order, int nrest, uint64_t seed, uint64_t npat, countfn count){
+    int nw = r.st.nw, i, k, from, to;
+    uint64_t b, g, s, lim, *val = &r.st.val[0];
+    tapefn fn = tapekern(nw);
+    vector<uint64_t> mask(nw);
+
+    r.ones.assign(Nnodes, 0);
+    r.togg.assign(Nnodes, 0);
+    r.first.assign(Nnodes, 0);
+    r.last.assign(Nnodes, 0);
+    for(b = r.pass0; b < r.pass1; b++) {
+        for(k = 0; k < nw; k++) {
+            g = b * nw + k;
+            s = lfsrseed(seed, g);
+            for(i = 0; i < Npi; i++) val[(size_t) Pinput[i]->indx * nw + k] = lfsr64(s);
+            lim = g * 64 < npat ? npat - g * 64 : 0;
+            mask[k] = lim >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << lim) - 1;
+        }
+        //Count every chunk of the tape right after it is evaluated, while its
+        //values are still in cache; the native simulator runs whole passes
+        if(Native && Native(val, nw) == 0) count(val, &order[0], Nnodes, &mask[0], b == r.pass0, &r.ones[0], &r.togg[0], &r.last[0]);
+        else {
+            count(val, &order[0], nrest, &mask[0], b == r.pass0, &r.ones[0], &r.togg[0], &r.last[0]);
+            for(from = 0; from < Ntape; from = to) {
+                to = from + RANDCHUNK < Ntape ? from + RANDCHUNK : Ntape;
+                fn(Tape, Tapefin, val, from, to);
+                count(val, &order[nrest + from], to - from, &mask[0], b == r.pass0,
+                      &r.ones[nrest + from], &r.togg[nrest + from], &r.last[nrest + from]);
+            }
+        }
+        r.st.evals += (long long) Ntape * nw;
+        if(b == r.pass0)
+            for(i = 0; i < Nnodes; i++) r.first[i] = val[(size_t) order[i] * nw] & 1;
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    RANDSIM [-S seed] n outfile simulates n (K, M or G for thousands,
+    millions or billions) pseudo-random patterns and writes, for every
+    node, "num,probability,activity": the fraction of the patterns where
+    it is 1 and the fraction of the n-1 consecutive pattern pairs where
+    it toggles. The passes are split into THREADS contiguous ranges, one
+    per thread; the toggles across the range boundaries are added when
+    the counts are merged.
+-----------------------------------------------------------------------*/
+void randsim(){
+    phasetimer timer(PH_LOGICSIM);
+    stringstream st(cp);
+    string arg, outfile;
+    uint64_t seed = 1, npat, npass, ngroup;
+    double n = 0, t0 = seconds(), sp = 0, sa = 0;
+    int i, w, nthr, nw = simdwords();
+    long long evals = 0;
+    char *e;
+    FILE *fp;
+
+    while(st>>arg && arg[0] == '-') {
+        if((arg == "-S" || arg == "-s") && st>>arg) seed = strtoull(arg.c_str(), NULL, 0);
+        else {
+            printf("Error: unknown option %s\n", arg.c_str());
+            return;
+        }
+    }
+    n = strtod(arg.c_str(), &e);
+    if(*e == 'K' || *e == 'k') n *= 1e3, e++;
+    else if(*e == 'M' || *e == 'm') n *= 1e6, e++;
+    else if(*e == 'G' || *e == 'g') n *= 1e9, e++;
+    if(arg.empty() || *e || n < 1 || !(st>>outfile)) {
+        printf("Error: RANDSIM [-S seed] n outfile\n");
+        return;
+    }
+    if(Tapelev == NULL && compile() < 0) return;
+    if(!Nativedir.empty() && Native == NULL) loadnative(0);
+    npat = (uint64_t) n;
+    ngroup = (npat + 63) / 64;
+    npass = (ngroup + nw - 1) / nw;
+    nthr = Nthreads < (long long) npass ? Nthreads : (int) npass;
+
+    countfn count = countkern(nw);
+    vector<uint32_t> order, pos(Nnodes);
+    vector<char> intape(Nnodes, 0);
+    int nrest;
+    for(i = 0; i < Ntape; i++) intape[Tape[i].out] = 1;
+    for(i = 0; i < Nnodes; i++)
+        if(!intape[i]) order.push_back(i);
+    nrest = order.size();
+    for(i = 0; i < Ntape; i++) order.push_back(Tape[i].out);
+    for(i = 0; i < Nnodes; i++) pos[order[i]] = i;
+
+    vector<randstruc> r(nthr);
+    vector<std::thread> thr;
+    for(w = 0; w < nthr; w++) {
+        r[w].st.init(nw);
+        r[w].pass0 = npass * w / nthr;
+        r[w].pass1 = npass * (w + 1) / nthr;
+        thr.push_back(std::thread(randpasses, std::ref(r[w]), std::cref(order), nrest, seed, npat, count));
+    }
+    for(w = 0; w < nthr; w++) thr[w].join();
+    for(w = 1; w < nthr; w++)
+        for(i = 0; i < Nnodes; i++) {
+            r[0].ones[i] += r[w].ones[i];
+            r[0].togg[i] += r[w].togg[i] + (r[w - 1].last[i] != r[w].first[i]);
+        }
+    for(w = 0; w < nthr; w++) evals += r[w].st.evals;
+    t0 = seconds() - t0;
+
+    if((fp = fopen(outfile.c_str(), "w")) == NULL) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    for(i = 0; i < Nnodes; i++) {
+        int k = FILEIDX(i), j = pos[k];
+        double p = (double) r[0].ones[j] / npat, a = npat > 1 ? (double) r[0].togg[j] / (npat - 1) : 0;
+
+        fprintf(fp, "%u,%.6f,%.6f\n", Node[k].num, p, a);
+        sp += p;
+        sa += a;
+    }
+    fclose(fp);
+    Stats.gateevals += evals;
+    Stats.vectors += npat;
+    printf("==> %llu patterns in %.2f s on %d thread%s, mean probability %.4f, mean activity %.4f",
+           (unsigned long long) npat, t0, nthr, nthr > 1 ? "s" : "", sp / Nnodes, sa / Nnodes);
+}
+
+/*=============================Fault Simulator============================*/
+/*-----------------------------------------------------------------------
+input: fault list to fill
+output: nothing
+called by: faultsim
+description:
+    Builds the full stuck-at-0/1 fault list: both faults on the output of
+    every node, which includes every PI, gate and BRCH fanout branch.
+-----------------------------------------------------------------------*/
+void faultlist(vector<FSTRUC> &flist){
+    FSTRUC f;
+    int i;
+
+    flist.clear();
+    f.det = -1;
+    for(i = 0; i < Nnodes; i++) {
+        f.node = FILEIDX(i);
+        f.sa = 0;
+        flist.push_back(f);
+        f.sa = 1;
+        flist.push_back(f);
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: fault list file name, fault list to fill
+output: 0 on success, -1 on error
+called by: faultsim
+description:
+    Reads a fault list with one "num@sa" fault per line, as written by
+    FCOLLAPSE. Unknown nodes and malformed lines are reported with their
+    line number.
+-----------------------------------------------------------------------*/
+int readfaults(const char *name, vector<FSTRUC> &flist){
+    vecreader in;
+    const char *s, *e;
+    int i, num, sa;
+    idmap ids;
+    FSTRUC f;
+
+    if(in.open(name) < 0) {
+        cerr<<"ERROR! We cannot read the fault list "<<name<<endl;
+        return -1;
+    }
+    ids.init(Nnodes);
+    for(i = 0; i < Nnodes; i++) ids.insert(Node[i].num, i);
+    flist.clear();
+    f.det = -1;
+    while(in.getline(s, e)) {
+        while(s < e && isspace(*s)) s++;
+        if(s == e) continue;
+        if(!scanint(s, e, num, "@") || s == e || *s++ != '@' || !scanint(s, e, sa) || (sa != 0 && sa != 1)) {
+            cerr<<"Error: line "<<in.nline<<": malformed fault, expected num@sa"<<endl;
+            return -1;
+        }
+        if((i = ids.find(num)) < 0) {
+            cerr<<"Error: line "<<in.nline<<": node "<<num<<" is not in the circuit"<<endl;
+            return -1;
+        }
+        f.node = i;
+        f.sa = sa;
+        flist.push_back(f);
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------
+Fault-cone propagation state of the parallel-pattern single-fault
+propagation simulator. Node n carries a faulty value fval[n] only when
+mark[n] == stamp; every other node still has its good value, so a new
+fault costs nothing to set up and nothing to clean up.
+-----------------------------------------------------------------------*/
+struct fcone {
+    vector<uint64_t> fval;
+    vector<unsigned> mark, qmark;
+    vector< vector<uint32_t> > evq;
+    unsigned stamp;
+
+    void init(){
+        fval.assign(Nnodes, 0);
+        mark.assign(Nnodes, 0);
+        qmark.assign(Nnodes, 0);
+        evq.assign(Nlevels, vector<uint32_t>());
+        stamp = 0;
+    }
+    uint64_t value(uint32_t n, const uint64_t *good) const{
+        return mark[n] == stamp ? fval[n] : good[n];
+    }
+    void schedule(uint32_t n){
+        uint32_t k, d;
+
+        for(k = Ckt.foutoff[n]; k < Ckt.foutoff[n + 1]; k++) {
+            d = Ckt.fanout[k];
+            if(qmark[d] == stamp) continue;
+            qmark[d] = stamp;
+            evq[Node[d].level].push_back(d);
+        }
+    }
+    uint64_t eval(uint32_t n, const uint64_t *good) const{
+        const uint32_t *f = Ckt.fanin + Ckt.finoff[n], *fend = Ckt.fanin + Ckt.finoff[n + 1];
+        uint64_t r;
+
+        switch(Ckt.type[n]) {
+            case BRCH:
+            case BUFFER:
+                return value(*f, good);
+            case NOT:
+                return ~value(*f, good);
+            case OR:
+            case NOR:
+                for(r = 0; f < fend; f++) r |= value(*f, good);
+                return Ckt.type[n] == NOR ? ~r : r;
+            case AND:
+            case NAND:
+                for(r = ~(uint64_t)0; f < fend; f++) r &= value(*f, good);
+                return Ckt.type[n] == NAND ? ~r : r;
+            case XOR:
+            case XNOR:
+                for(r = 0; f < fend; f++) r ^= value(*f, good);
+                return Ckt.type[n] == XNOR ? ~r : r;
+            default:
+                return good[n];
+        }
+    }
+    /* patterns (bits) of good that detect fault f at some PO */
+    uint64_t simulate(const FSTRUC &f, const uint64_t *good, const vector<char> &ispo){
+        uint64_t r, det = 0;
+        uint32_t n = f.node;
+        int l;
+        size_t j;
+        long long nevals = 0;
+
+        if(++stamp == 0) {              //wrapped around, forget old marks
+            mark.assign(Nnodes, 0);
+            qmark.assign(Nnodes, 0);
+            stamp = 1;
+        }
+        fval[n] = f.sa ? ~(uint64_t)0 : 0;
+        mark[n] = stamp;
+        if(ispo[n]) det |= fval[n] ^ good[n];
+        schedule(n);
+        for(l = Node[n].level + 1; l < Nlevels; l++) {
+            for(j = 0; j < evq[l].size(); j++) {
+                n = evq[l][j];
+                r = eval(n, good);
+                nevals++;
+                if(r == good[n]) continue;      //fault effect dies here
+                fval[n] = r;
+                mark[n] = stamp;
+                if(ispo[n]) det |= r ^ good[n];
+                schedule(n);
+            }
+            evq[l].clear();
+        }
+        Stats.gateevals += nevals;
+        return det;
+    }
+};
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    FAULTSIM infile outfile: parallel-pattern single-fault-propagation
+    stuck-at fault simulation. The vectors of infile are simulated 64 at a
+    time over the compiled tape; then every fault still undetected is
+    injected at its node and propagated through its fanout cone only,
+    level by level, stopping where its effect disappears. A fault not
+    activated by any of the 64 patterns is skipped without propagation,
+    and a detected fault is dropped for the rest of the run.
+    outfile gets one line per vector with the faults it detects first,
+    written as "vector: num@sa ...". The coverage, fault-dropping
+    statistics and throughput are printed at the end.
+    With a faultfile (FCOLLAPSE output) only the faults listed there are
+    simulated and the coverage is relative to that list.
+-----------------------------------------------------------------------*/
+void faultsim(){
+    phasetimer timer(PH_FAULTSIM);
+    stringstream st(cp);
+    string inputfile, outputfile, faultfile;
+    int i, p, npat, nvec = 0, nblock = 0, ndet = 0, nleft, ndropped;
+    long long nsim = 0, nskip = 0;
+    uint64_t valid, act, det;
+    size_t j;
+    double t0;
+    vector<FSTRUC> flist;
+    vector<uint32_t> live;
+    vector<int> pival(Npi);
+    vector<uint64_t> piword;
+    vector< vector<uint32_t> > bydet(64);
+    vector<char> ispo(Nnodes, 0);
+    vecreader in;
+    vecwriter out;
+    fcone cone;
+
+    st>>inputfile;
+    st>>outputfile;
+    st>>faultfile;
+    if(Tapelev == NULL && compile() < 0) return;
+    if(!faultfile.empty() && readfaults(faultfile.c_str(), flist) < 0) return;
+    if(in.open(inputfile.c_str()) < 0) {
+        cerr<<"ERROR! We cannot read the input file!!"<<endl;
+        return;
+    }
+    if(out.open(outputfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    t0 = seconds();
+    if(faultfile.empty()) faultlist(flist);
+    for(j = 0; j < flist.size(); j++) live.push_back(j);
+    for(i = 0; i < Npo; i++) ispo[Poutput[i]->indx] = 1;
+    for(i = 0; i < Npi; i++) pival[i] = Pinput[i]->value;
+    cone.init();
+
+    while(!live.empty() && (npat = readblock(in, pival, piword)) > 0) {
+        valid = npat == 64 ? ~(uint64_t)0 : ((uint64_t)1 << npat) - 1;
+        for(i = 0; i < Npi; i++) Pvalue[Pinput[i]->indx] = piword[i];
+        tapesim(Pvalue);
+
+        //Simulate the live faults, compacting the ones left undetected
+        nleft = 0;
+        for(j = 0; j < live.size(); j++) {
+            FSTRUC &f = flist[live[j]];
+            act = (f.sa ? ~Pvalue[f.node] : Pvalue[f.node]) & valid;
+            det = 0;
+            if(act) {
+                det = cone.simulate(f, Pvalue, ispo) & valid;
+                nsim++;
+            }
+            else nskip++;
+            if(det) {
+                p = __builtin_ctzll(det);
+                f.det = nvec + p;
+                bydet[p].push_back(live[j]);
+            }
+            else live[nleft++] = live[j];
+        }
+        ndropped = live.size() - nleft;
+        live.resize(nleft);
+        ndet += ndropped;
+
+        for(p = 0; p < npat; p++) {
+            out.putint(nvec + p);
+            out.put(':');
+            for(j = 0; j < bydet[p].size(); j++) {
+                out.put(' ');
+                out.putint(Node[flist[bydet[p][j]].node].num);
+                out.put('@');
+                out.putint(flist[bydet[p][j]].sa);
+            }
+            out.put('\n');
+            bydet[p].clear();
+        }
+        VERB(1) if(ndropped > 0)
+            printf("block %d (vectors %d-%d): %d faults dropped, %d left\n",
+                   nblock, nvec, nvec + npat - 1, ndropped, nleft);
+        nvec += npat;
+        nblock++;
+    }
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outputfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    Stats.vectors += nvec;
+    t0 = seconds() - t0;
+    printf("==> %d faults, %d detected, coverage %.2f%%\n", (int)flist.size(), ndet,
+           flist.empty() ? 0.0 : 100.0 * ndet / flist.size());
+    printf("    %d vectors in %d blocks of 64, %lld fault propagations, %lld skipped as not activated\n",
+           nvec, nblock, nsim, nskip);
+    printf("    %.3f s, %.0f faults/s, %.0f fault propagations/s",
+           t0, t0 > 0 ? flist.size() / t0 : 0.0, t0 > 0 ? nsim / t0 : 0.0);
+}
+
+/*=============================Fault Collapsing===========================*/
+/*-----------------------------------------------------------------------
+Union-find over the 2*Nnodes stuck-at faults, fault id 2*node+sa. The root
+of a class is the member on the lowest level (then first in file order),
+so each equivalence class is represented by its fault closest to the PIs.
+-----------------------------------------------------------------------*/
+struct fclass {
+    vector<int> up;
+    vector<int> pos;            /* fault x -> its place in file order */
+
+    void init(int n){
+        up.resize(n);
+        pos.resize(n);
+        for(int i = 0; i < n; i++) up[i] = i;
+        for(int i = 0; i < n; i++) pos[2 * FILEIDX(i / 2) + i % 2] = i;
+    }
+    int find(int x){
+        while(up[x] != x) x = up[x] = up[up[x]];
+        return x;
+    }
+    void unite(int a, int b){
+        a = find(a);
+        b = find(b);
+        if(a == b) return;
+        if(Node[b / 2].level < Node[a / 2].level ||
+           (Node[b / 2].level == Node[a / 2].level && pos[b] < pos[a])) swap(a, b);
+        up[b] = a;
+    }
+};
+
+/*-----------------------------------------------------------------------
+input: fault list to fill
+output: nothing
+called by: fcollapse
+description:
+    Collapses the full fault list with the gate rules gatefunction() is
+    built on. A fanin x of gate n can only be merged when x lies in a
+    fanout-free region, i.e. it has fout == 1 and is not a PO; with BRCH
+    nodes explicit in the self format, stems are never merged with their
+    branches.
+      equivalence: AND/NAND/OR/NOR: x sa-c == n sa-(c^inv), c being the
+                   controlling value; NOT: x sa-v == n sa-!v;
+                   BUFFER/BRCH: x sa-v == n sa-v.
+      dominance:   AND/NAND/OR/NOR: n sa-(!c^inv) dominates x sa-!c, so
+                   the output fault is dropped when n has such a fanin.
+    A class is dropped when any of its faults is dominated away; every
+    other class contributes its representative.
+-----------------------------------------------------------------------*/
+void collapse(vector<FSTRUC> &flist){
+    int n, x, c, inv, ffr, j;
+    uint32_t k;
+    fclass fc;
+    FSTRUC f;
+    vector<char> drop(2 * Nnodes, 0);
+
+    fc.init(2 * Nnodes);
+    for(n = 0; n < Nnodes; n++) {
+        switch(Ckt.type[n]) {
+            case AND:  c = 0; inv = 0; break;
+            case NAND: c = 0; inv = 1; break;
+            case OR:   c = 1; inv = 0; break;
+            case NOR:  c = 1; inv = 1; break;
+            case NOT:
+            case BUFFER:
+            case BRCH: c = -1; inv = Ckt.type[n] == NOT; break;
+            default:   continue;
+        }
+        ffr = 0;
+        for(k = Ckt.finoff[n]; k < Ckt.finoff[n + 1]; k++) {
+            x = Ckt.fanin[k];
+            if(Ckt.foutoff[x + 1] - Ckt.foutoff[x] != 1 || Node[x].ntype == PO) continue;
+            ffr = 1;
+            if(c < 0) {
+                fc.unite(2 * x, 2 * n + inv);
+                fc.unite(2 * x + 1, 2 * n + !inv);
+            }
+            else fc.unite(2 * x + c, 2 * n + (c ^ inv));
+        }
+        if(c >= 0 && ffr) drop[2 * n + (!c ^ inv)] = 1;
+    }
+    for(x = 0; x < 2 * Nnodes; x++)
+        if(drop[x]) drop[fc.find(x)] = 1;
+    flist.clear();
+    f.det = -1;
+    for(j = 0; j < 2 * Nnodes; j++) {
+        x = 2 * FILEIDX(j / 2) + j % 2;
+        if(fc.find(x) != x || drop[x]) continue;
+        f.node = x / 2;
+        f.sa = x % 2;
+        flist.push_back(f);
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    FCOLLAPSE outfile: writes the collapsed fault list, one "num@sa" per
+    line, for later FAULTSIM runs.
+-----------------------------------------------------------------------*/
+void fcollapse(){
+    phasetimer timer(PH_FCOLLAPSE);
+    stringstream st(cp);
+    string outputfile;
+    vector<FSTRUC> flist;
+    vecwriter out;
+    size_t j;
+
+    st>>outputfile;
+    if(Nlevels == 0 && levelize() < 0) return;
+    if(out.open(outputfile.c_str()) < 0) {
+        cerr<<"Cannot open a output file to write"<<endl;
+        return;
+    }
+    collapse(flist);
+    for(j = 0; j < flist.size(); j++) {
+        out.putint(Node[flist[j].node].num);
+        out.put('@');
+        out.putint(flist[j].sa);
+        out.put('\n');
+    }
+    if(out.close() < 0) {
+        cerr<<"Error: cannot write "<<outputfile<<": "<<strerror(errno)<<endl;
+        return;
+    }
+    printf("==> %d faults collapsed to %d (%.2f%%)", 2 * Nnodes, (int)flist.size(),
+           Nnodes ? 100.0 * flist.size() / (2 * Nnodes) : 0.0);
+}
+
+/*============================Netlist Edits (ECO)=========================*/
+/*-----------------------------------------------------------------------
+ECO edits the live circuit in Node: the gate type of a node, a fanin
+added or removed, or a buffer inserted on a fanout. The unodes/dnodes
+arrays an edit grows are allocated on their own and kept in Eco.arrays;
+Node.level and Node.value are then brought up to date in the fanout cone
+of the edit only (see ecoupdate()). Everything else that is derived from
+the topology (Ckt, the level buckets, the tape, the cones, the native
+simulator) is dropped by the edit and rebuilt on first use: levelize()
+and pc() call ecosync(), which lays Ckt and the pools out again from
+Node. An edited circuit no longer matches its file, so it is not saved
+to the cache and a READ of the file reads it again.
+-----------------------------------------------------------------------*/
+struct ecostruc {
+    int edits;                      /* edits since READ */
+    int dirty;                      /* Ckt and the pools are behind Node */
+    vector<NSTRUC **> arrays;       /* unodes/dnodes arrays outside the pools */
+    NSTRUC *base;                   /* Node of cap, see ecogrow() */
+    int cap;                        /* nodes allocated in base */
+    idmap ids;                      /* node number -> index, see econode() */
+    NSTRUC *idnode;                 /* Node and Nnodes ids was built for */
+    int idn;
+
+    ecostruc() : edits(0), dirty(0), base(NULL), cap(0), idnode(NULL), idn(0) {}
+};
+static ecostruc Eco;
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: clear
+description:
+    Frees the arrays of the edits and forgets the edits.
+-----------------------------------------------------------------------*/
+void freeeco(){
+    size_t j;
+
+    for(j = 0; j < Eco.arrays.size(); j++) free(Eco.arrays[j]);
+    Eco = ecostruc();
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: levelize, pc
+description:
+    Rebuilds the CSR arrays of Ckt and the unodes/dnodes pools from Node
+    after edits, in the order of Node.unodes/Node.dnodes, and frees the
+    arrays of the edits. Does nothing if there were no edits since the
+    last call. A mapped cache is unmapped, Ckt is allocated again.
+-----------------------------------------------------------------------*/
+void ecosync(){
+    NSTRUC *np, **upool, **dpool;
+    uint32_t k, nf = 0, no = 0;
+    size_t j;
+    int i;
+
+    if(!Eco.dirty) return;
+    for(Nedges = 0, i = 0; i < Nnodes; i++) Nedges += Node[i].fin;
+    freeckt();
+    Ckt.finoff = (uint32_t *) cmalloc((Nnodes + 1) * sizeof(uint32_t));
+    Ckt.fanin = (uint32_t *) cmalloc(Nedges * sizeof(uint32_t));
+    Ckt.foutoff = (uint32_t *) cmalloc((Nnodes + 1) * sizeof(uint32_t));
+    Ckt.fanout = (uint32_t *) cmalloc(Nedges * sizeof(uint32_t));
+    Ckt.type = (unsigned char *) cmalloc(Nnodes);
+    upool = (NSTRUC **) cmalloc(Nedges * sizeof(NSTRUC *));
+    dpool = (NSTRUC **) cmalloc(Nedges * sizeof(NSTRUC *));
+    for(i = 0; i < Nnodes; i++) {
+        np = &Node[i];
+        Ckt.finoff[i] = nf;
+        Ckt.foutoff[i] = no;
+        Ckt.type[i] = np->type;
+        for(k = 0; k < np->fin; k++, nf++) {
+            upool[nf] = np->unodes[k];
+            Ckt.fanin[nf] = np->unodes[k]->indx;
+        }
+        for(k = 0; k < np->fout; k++, no++) {
+            dpool[no] = np->dnodes[k];
+            Ckt.fanout[no] = np->dnodes[k]->indx;
+        }
+        np->unodes = upool + Ckt.finoff[i];
+        np->dnodes = dpool + Ckt.foutoff[i];
+    }
+    Ckt.finoff[Nnodes] = nf;
+    Ckt.foutoff[Nnodes] = no;
+    free(Upool);
+    free(Dpool);
+    Upool = upool;
+    Dpool = dpool;
+    for(j = 0; j < Eco.arrays.size(); j++) free(Eco.arrays[j]);
+    Eco.arrays.clear();
+    Eco.dirty = 0;
+}
+
+/* node of number num, NULL if there is none; the id map is built on the
+   first lookup and kept up to date by the edits */
+static NSTRUC *econode(int num){
+    int i;
+
+    if(Eco.idnode != Node || Eco.idn != Nnodes) {
+        Eco.ids.init(Nnodes);
+        for(i = 0; i < Nnodes; i++) Eco.ids.insert(Node[i].num, i);
+        Eco.idnode = Node;
+        Eco.idn = Nnodes;
+    }
+    i = Eco.ids.find(num);
+    return i < 0 ? NULL : &Node[i];
+}
+
+/* a new unodes/dnodes array of n entries, freed by ecosync() or clear() */
+static NSTRUC **ecoarray(unsigned n){
+    NSTRUC **a = (NSTRUC **) cmalloc((n ? n : 1) * sizeof(NSTRUC *));
+
+    Eco.arrays.push_back(a);
+    return a;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: eco
+description:
+    Makes room in Node (and Pvalue, Fileorder) for one more node. The
+    capacity doubles, so inserting n nodes copies O(n) nodes in all.
+    When Node moves, every pointer to a node is moved with it.
+-----------------------------------------------------------------------*/
+static void ecogrow(){
+    NSTRUC *old = Node, *node;
+    uint64_t *pvalue;
+    int *fileorder = NULL;
+    int cap = Node == Eco.base ? Eco.cap : Nnodes, i;
+    unsigned k;
+
+    if(Nnodes < cap) return;
+    cap = 2 * Nnodes + 16;
+    node = (NSTRUC *) cmalloc(cap * sizeof(NSTRUC));
+    memcpy(node, Node, Nnodes * sizeof(NSTRUC));
+    for(i = 0; i < Nnodes; i++) {
+        for(k = 0; k < node[i].fin; k++) node[i].unodes[k] = node + (node[i].unodes[k] - old);
+        for(k = 0; k < node[i].fout; k++) node[i].dnodes[k] = node + (node[i].dnodes[k] - old);
+    }
+    for(i = 0; i < Npi; i++) Pinput[i] = node + (Pinput[i] - old);
+    for(i = 0; i < Npo; i++) Poutput[i] = node + (Poutput[i] - old);
+    pvalue = (uint64_t *) cmalloc(cap * sizeof(uint64_t));
+    memcpy(pvalue, Pvalue, Nnodes * sizeof(uint64_t));
+    if(Fileorder) {
+        fileorder = (int *) cmalloc(cap * sizeof(int));
+        memcpy(fileorder, Fileorder, Nnodes * sizeof(int));
+    }
+    free(Node);
+    free(Pvalue);
+    free(Fileorder);
+    Node = node;
+    Pvalue = pvalue;
+    Fileorder = fileorder;
+    if(Eco.idnode == old) Eco.idnode = Node;
+    Eco.base = Node;
+    Eco.cap = cap;
+}
+
+/* value of np from the values of its up nodes, three-valued */
+static int ecoeval(const NSTRUC *np){
+    int one = 0, zero = 0, x = 0;
+    unsigned k;
+
+    if(np->type == IPT || np->fin == 0) return np->value;
+    for(k = 0; k < np->fin; k++) {
+        if(np->unodes[k]->value == VALX) x++;
+        else if(np->unodes[k]->value) one++;
+        else zero++;
+    }
+    switch(np->type) {
+        case BRCH:
+        case BUFFER: return x ? VALX : one;
+        case NOT: return x ? VALX : !one;
+        case AND: return zero ? 0 : x ? VALX : 1;
+        case NAND: return zero ? 1 : x ? VALX : 0;
+        case OR: return one ? 1 : x ? VALX : 0;
+        case NOR: return one ? 0 : x ? VALX : 1;
+        case XOR: return x ? VALX : one & 1;
+        case XNOR: return x ? VALX : !(one & 1);
+        default: return VALX;
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: seed nodes (level key, index), counters to fill, PO changes to fill
+output: nothing
+called by: eco
+description:
+    Brings Node.level and Node.value up to date after an edit, starting
+    from the seed nodes. Nodes are processed in the order of their level
+    before the edit, which is a topological order of the fanout cone, so
+    every node is looked at once and after all of its up nodes. Only the
+    down nodes of a node whose level or value changed are queued, so the
+    work stops where the edit stops mattering under the current values.
+-----------------------------------------------------------------------*/
+static void ecoupdate(const vector< pair<int, unsigned> > &seed, int &neval, int &nlev,
+                      vector< pair<NSTRUC *, int> > &pochg){
+    priority_queue< pair<int, unsigned>, vector< pair<int, unsigned> >, greater< pair<int, unsigned> > > heap;
+    unordered_set<unsigned> queued;
+    NSTRUC *np, *dp;
+    unsigned k;
+    size_t j;
+    int l, v;
+
+    for(j = 0; j < seed.size(); j++)
+        if(queued.insert(seed[j].second).second) heap.push(seed[j]);
+    while(!heap.empty()) {
+        np = &Node[heap.top().second];
+        heap.pop();
+        for(l = 0, k = 0; k < np->fin; k++) l = max(l, np->unodes[k]->level + 1);
+        v = ecoeval(np);
+        neval++;
+        if(l == np->level && v == np->value) continue;
+        if(l != np->level) {
+            np->level = l;
+            nlev++;
+        }
+        if(v != np->value) {
+            if(np->ntype == PO) pochg.push_back(make_pair(np, np->value));
+            np->value = v;
+        }
+        for(k = 0; k < np->fout; k++) {
+            dp = np->dnodes[k];
+            if(queued.insert(dp->indx).second) heap.push(make_pair(dp->level, dp->indx));
+        }
     }
-    outfile.close();
-    cout<<"*****Finish Writing the output file*****"<<endl<<endl;
 }
-//Final function we want: logicsim()
-void logicsim(){
+
+/* 1 if f is in the fanout cone of np; only nodes below the level of f
+   can reach it */
+static int ecoreaches(NSTRUC *np, NSTRUC *f){
+    vector<NSTRUC *> stack(1, np);
+    unordered_set<unsigned> seen;
+    unsigned k;
+
+    while(!stack.empty()) {
+        np = stack.back();
+        stack.pop_back();
+        if(np == f) return 1;
+        if(np->level >= f->level) continue;
+        for(k = 0; k < np->fout; k++)
+            if(seen.insert(np->dnodes[k]->indx).second) stack.push_back(np->dnodes[k]);
+    }
+    return 0;
+}
+
+/* drops what was derived from the topology before an edit, see ecosync() */
+static void ecoinvalidate(){
+    free(Levnode);
+    free(Levstart);
+    Levnode = Levstart = NULL;
+    Nlevels = 0;
+    free(Tape);
+    free(Tapefin);
+    free(Tapelev);
+    free(Phasestart);
+    free(Phasepar);
+    Tape = NULL;
+    Tapefin = NULL;
+    Tapelev = NULL;
+    Phasestart = NULL;
+    Phasepar = NULL;
+    freecones();
+    freenative();
+    Srcname.clear();                /* no longer the circuit of the file, see cachelevels() */
+    Eco.dirty = 1;
+    Eco.edits++;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    ECO TYPE n gate   changes the gate type of node n (name as PC
+                      prints it or number as in the circuit file)
+    ECO ADD n f       adds node f to the fanins of node n
+    ECO DEL n f       removes node f from the fanins of node n
+    ECO BUF n d m     inserts a buffer, new node m, between node n and
+                      its fanout d
+    The edit is checked first (no edits of PIs, one fanin for NOT,
+    BUFFER and BRCH, no loops) and refused as a whole. Then the levels
+    and the values of the last vector of LOGICSIM are updated in the
+    fanout cone of the edit only, and the gates evaluated, the levels
+    changed and the POs whose value changed are reported.
+-----------------------------------------------------------------------*/
+void eco(){
     stringstream st(cp);
-    string inputfile, outputfile;
-    st>>inputfile;
-    st>>outputfile;
-    inputFilename=inputfile;
-    outputFilename=outputfile;
-    readfile();
-    circuit_value_calculation();
-    outfilewriting();
+    string op, arg;
+    NSTRUC *np, *fp = NULL, *bp;
+    int n = -1, f = -1, m = -1, t = -1, neval = 0, nlev = 0;
+    unsigned k, ni, di;
+    size_t j;
+    double t0;
+    vector< pair<int, unsigned> > seed;
+    vector< pair<NSTRUC *, int> > pochg;
+    char msg[128];
+
+    st>>op>>n>>arg;
+    for(j = 0; j < op.size(); j++) op[j] = Upcase(op[j]);
+    if(op == "TYPE") {
+        for(j = 0; j < arg.size(); j++) arg[j] = Upcase(arg[j]);
+        if(isdigit(arg[0])) t = atoi(arg.c_str());
+        else for(t = BRCH; t <= BUFFER && gname(t) != arg; t++) ;
+        if(t < BRCH || t > BUFFER) {
+            printf("Error: unknown gate type %s\n", arg.c_str());
+            return;
+        }
+    }
+    else if(op == "ADD" || op == "DEL" || op == "BUF") f = atoi(arg.c_str());
+    if((op != "TYPE" && op != "ADD" && op != "DEL" && op != "BUF") || arg.empty() || (op == "BUF" && !(st>>m))) {
+        printf("Error: ECO TYPE n gate | ADD n f | DEL n f | BUF n d newnum\n");
+        return;
+    }
+    if(Eco.edits == 0 && Nlevels == 0 && levelize() < 0) return;
+    t0 = seconds();
+    if((np = econode(n)) == NULL || (f >= 0 && (fp = econode(f)) == NULL)) {
+        printf("Error: no node %d\n", np ? f : n);
+        return;
+    }
+    if(np->type == IPT || np->ntype == PI) {
+        printf("Error: %d is a primary input\n", n);
+        return;
+    }
+
+    if(op == "TYPE") {
+        if((t == NOT || t == BUFFER || t == BRCH) && np->fin != 1) {
+            printf("Error: %d has %u fanins, %s takes one\n", n, np->fin, gname(t).c_str());
+            return;
+        }
+        snprintf(msg, sizeof(msg), "%s -> %s", gname(np->type).c_str(), gname(t).c_str());
+        np->type = (enum e_gtype) t;
+        seed.push_back(make_pair(np->level, np->indx));
+    }
+    else if(op == "ADD") {
+        if(np->type == NOT || np->type == BUFFER || np->type == BRCH) {
+            printf("Error: %d is a %s, it takes one fanin\n", n, gname(np->type).c_str());
+            return;
+        }
+        for(k = 0; k < np->fin && np->unodes[k] != fp; k++) ;
+        if(k < np->fin) {
+            printf("Error: %d is a fanin of %d already\n", f, n);
+            return;
+        }
+        if(ecoreaches(np, fp)) {
+            printf("Error: %d is in the fanout cone of %d, that would be a loop\n", f, n);
+            return;
+        }
+        NSTRUC **a = ecoarray(np->fin + 1);
+        memcpy(a, np->unodes, np->fin * sizeof(NSTRUC *));
+        a[np->fin++] = fp;
+        np->unodes = a;
+        a = ecoarray(fp->fout + 1);
+        memcpy(a, fp->dnodes, fp->fout * sizeof(NSTRUC *));
+        a[fp->fout++] = np;
+        fp->dnodes = a;
+        snprintf(msg, sizeof(msg), "fanin %d added", f);
+        seed.push_back(make_pair(np->level, np->indx));
+    }
+    else if(op == "DEL") {
+        for(k = 0; k < np->fin && np->unodes[k] != fp; k++) ;
+        if(k == np->fin) {
+            printf("Error: %d is not a fanin of %d\n", f, n);
+            return;
+        }
+        if(np->fin == 1) {
+            printf("Error: %d is the only fanin of %d\n", f, n);
+            return;
+        }
+        for(np->fin--; k < np->fin; k++) np->unodes[k] = np->unodes[k + 1];
+        for(k = 0; fp->dnodes[k] != np; k++) ;
+        for(fp->fout--; k < fp->fout; k++) fp->dnodes[k] = fp->dnodes[k + 1];
+        snprintf(msg, sizeof(msg), "fanin %d removed", f);
+        seed.push_back(make_pair(np->level, np->indx));
+    }
+    else {
+        for(k = 0; k < np->fout && np->dnodes[k] != fp; k++) ;
+        if(k == np->fout) {
+            printf("Error: %d is not a fanout of %d\n", f, n);
+            return;
+        }
+        if(m < 0 || econode(m)) {
+            printf("Error: %d cannot be the number of a new node\n", m);
+            return;
+        }
+        ni = np->indx;
+        di = fp->indx;
+        ecogrow();                  /* may move Node */
+        np = &Node[ni];
+        fp = &Node[di];
+        bp = &Node[Nnodes];
+        bp->indx = Nnodes;
+        bp->num = m;
+        bp->ntype = GATE;
+        bp->type = BUFFER;
+        bp->fin = bp->fout = 1;
+        bp->unodes = ecoarray(1);
+        bp->dnodes = ecoarray(1);
+        bp->unodes[0] = np;
+        bp->dnodes[0] = fp;
+        bp->level = -1;
+        bp->value = np->value;
+        Pvalue[Nnodes] = 0;
+        if(Fileorder) Fileorder[Nnodes] = Nnodes;
+        np->dnodes[k] = bp;
+        for(k = 0; fp->unodes[k] != np; k++) ;
+        fp->unodes[k] = bp;
+        Nnodes++;
+        if(Eco.idnode == Node && Eco.idn == Nnodes - 1 && 2 * Nnodes <= (int) Eco.ids.key.size()) {
+            Eco.ids.insert(m, bp->indx);
+            Eco.idn = Nnodes;
+        }
+        snprintf(msg, sizeof(msg), "buffer %d inserted before %d", m, f);
+        seed.push_back(make_pair(np->level, bp->indx));
+        seed.push_back(make_pair(fp->level, fp->indx));
+    }
+    ecoinvalidate();
+    ecoupdate(seed, neval, nlev, pochg);
+    Stats.gateevals += neval;
+    printf("==> %d: %s, %d gate%s evaluated, %d level%s changed, %d PO%s changed", n, msg, neval, neval == 1 ? "" : "s",
+           nlev, nlev == 1 ? "" : "s", (int) pochg.size(), pochg.size() == 1 ? "" : "s");
+    for(j = 0; j < pochg.size() && j < 10; j++)
+        printf("%s %d %d->%d", j ? "," : ":", pochg[j].first->num, pochg[j].second, pochg[j].first->value);
+    if(j < pochg.size()) printf(", ...");
+    printf(" (%.1f us)", (seconds() - t0) * 1e6);
+}
+
+/*===========================Circuit Registry=============================*/
+/*-----------------------------------------------------------------------
+READ no longer throws the loaded circuit away: the per-circuit globals
+(Node, Ckt, the levels, the tape, the cones, the native simulator, ...)
+are parked in a cktstruc of the registry and the new circuit is built in
+their place. The registry is keyed by the real path and mtime of the
+circuit file, so a READ of a parked, unchanged file and USE only swap
+the globals back, which takes microseconds. The circuit in the globals
+is the current one; it is never evicted. While the circuits take more
+than Budget bytes, the least recently used parked one is dropped.
+-----------------------------------------------------------------------*/
+struct cktstruc {
+    /* registry key and bookkeeping */
+    string path;                    /* real path of the circuit file */
+    int64_t mtime, mtimens;
+    double lastuse;                 /* seconds() when it was last current */
+
+    /* the globals of the circuit, see swapckt() */
+    enum e_state gstate;
+    NSTRUC *node;
+    NSTRUC **pinput, **poutput;
+    uint64_t *pvalue;
+    int nlevels;
+    int *levstart, *levnode;
+    TSTRUC *tape;
+    uint32_t *tapefin;
+    int ntape;
+    int *tapelev;
+    int nphase;
+    int *phasestart;
+    unsigned char *phasepar;
+    CSTRUC ckt;
+    NSTRUC **upool, **dpool;
+    int *pislot;
+    int npislot;
+    int *fileorder;
+    int nnodes, nedges, npi, npo;
+    nativefn native;
+    void *nativelib;
+    vector<conestruc> cones;
+    void *cktmap;
+    size_t cktmapsize;
+    string srcname;
+    struct stat srcstat;
+    int cachelev;
+    ecostruc eco;
+
+    /* an empty state, the one of the globals before the first READ */
+    cktstruc() : mtime(0), mtimens(0), lastuse(0), gstate(EXEC), node(NULL), pinput(NULL), poutput(NULL),
+                 pvalue(NULL), nlevels(0), levstart(NULL), levnode(NULL), tape(NULL), tapefin(NULL), ntape(0),
+                 tapelev(NULL), nphase(0), phasestart(NULL), phasepar(NULL), upool(NULL), dpool(NULL), pislot(NULL),
+                 npislot(0), fileorder(NULL), nnodes(0), nedges(0), npi(0), npo(0), native(NULL), nativelib(NULL),
+                 cktmap(NULL), cktmapsize(0), cachelev(0){
+        memset(&ckt, 0, sizeof(ckt));
+        memset(&srcstat, 0, sizeof(srcstat));
+    }
+};
+
+static vector<cktstruc> Parked;     /* circuits other than the current one */
+static cktstruc Current;            /* registry key of the current circuit (globals unused) */
+static size_t Budget;               /* bytes the circuits may take, 0 for no limit */
+
+/* exchanges the globals of the current circuit with those kept in c */
+static void swapckt(cktstruc &c){
+    swap(Gstate, c.gstate);
+    swap(Node, c.node);
+    swap(Pinput, c.pinput);
+    swap(Poutput, c.poutput);
+    swap(Pvalue, c.pvalue);
+    swap(Nlevels, c.nlevels);
+    swap(Levstart, c.levstart);
+    swap(Levnode, c.levnode);
+    swap(Tape, c.tape);
+    swap(Tapefin, c.tapefin);
+    swap(Ntape, c.ntape);
+    swap(Tapelev, c.tapelev);
+    swap(Nphase, c.nphase);
+    swap(Phasestart, c.phasestart);
+    swap(Phasepar, c.phasepar);
+    swap(Ckt, c.ckt);
+    swap(Upool, c.upool);
+    swap(Dpool, c.dpool);
+    swap(Pislot, c.pislot);
+    swap(Npislot, c.npislot);
+    swap(Fileorder, c.fileorder);
+    swap(Nnodes, c.nnodes);
+    swap(Nedges, c.nedges);
+    swap(Npi, c.npi);
+    swap(Npo, c.npo);
+    swap(Native, c.native);
+    swap(Nativelib, c.nativelib);
+    Cones.swap(c.cones);
+    swap(Cktmap, c.cktmap);
+    swap(Cktmapsize, c.cktmapsize);
+    Srcname.swap(c.srcname);
+    swap(Srcstat, c.srcstat);
+    swap(Cachelev, c.cachelev);
+    swap(Eco, c.eco);
+    swap(Current.path, c.path);
+    swap(Current.mtime, c.mtime);
+    swap(Current.mtimens, c.mtimens);
+    swap(Current.lastuse, c.lastuse);
+}
+
+/* resident bytes of the current circuit */
+static size_t cktbytes(){
+    size_t b = 0, c;
+
+    if(Gstate != CKTLD) return 0;
+    b += (size_t) Nnodes * (sizeof(NSTRUC) + sizeof(uint64_t)) + 2 * (size_t) Nedges * sizeof(NSTRUC *);
+    b += (size_t) (Npi + Npo) * sizeof(NSTRUC *) + (size_t) Npislot * sizeof(int);
+    b += Cktmap ? Cktmapsize : 2 * (size_t) (Nnodes + 1 + Nedges) * sizeof(uint32_t) + Nnodes;
+    if(Fileorder) b += (size_t) Nnodes * sizeof(int);
+    if(Nlevels) b += (size_t) (Nlevels + 1 + Nnodes) * sizeof(int);
+    if(Tapelev) b += (size_t) Ntape * sizeof(TSTRUC) + (size_t) Nedges * sizeof(uint32_t) + (size_t) (Nlevels + 1) * (2 * sizeof(int) + 1);
+    for(c = 0; c < Cones.size(); c++) b += Cones[c].tape.size() * sizeof(TSTRUC);
+    return b;
+}
+
+/* registry index of the circuit named by s: its number in LIST or its file */
+static int findckt(const string &s){
+    char path[PATH_MAX];
+    char *e;
+    long i = strtol(s.c_str(), &e, 10);
+    size_t j;
+
+    if(*e == '\0' && !s.empty()) return i >= 1 && i <= (long) Parked.size() ? i - 1 : -1;
+    if(realpath(s.c_str(), path) == NULL) snprintf(path, sizeof(path), "%s", s.c_str());
+    for(j = 0; j < Parked.size(); j++)
+        if(Parked[j].path == path) return j;
+    return -1;
+}
+
+/* frees the parked circuit i */
+static void dropparked(int i){
+    swapckt(Parked[i]);
+    clear();
+    swapckt(Parked[i]);
+    Parked.erase(Parked.begin() + i);
+}
+
+/* drops least recently used parked circuits until the budget is met */
+static void evict(){
+    size_t total, j, lru;
+
+    while(Budget && !Parked.empty()) {
+        total = cktbytes();
+        for(j = 0, lru = 0; j < Parked.size(); j++) {
+            swapckt(Parked[j]);
+            total += cktbytes();
+            swapckt(Parked[j]);
+            if(Parked[j].lastuse < Parked[lru].lastuse) lru = j;
+        }
+        if(total <= Budget) break;
+        VERB(1) printf("dropping %s (least recently used)\n", Parked[lru].path.c_str());
+        dropparked(lru);
+    }
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: cread, loadcache
+description:
+    Parks the current circuit, if any, in the registry and leaves empty
+    globals for the circuit about to be built. Replaces the clear() that
+    READ used to do.
+-----------------------------------------------------------------------*/
+void parkcircuit(){
+    if(Gstate != CKTLD) return;
+    Current.lastuse = seconds();
+    Parked.push_back(cktstruc());
+    swapckt(Parked.back());
+}
+
+/*-----------------------------------------------------------------------
+input: circuit file name, its stat
+output: nothing
+called by: cread
+description:
+    Records the key of the circuit just read, drops parked circuits of
+    the same file (older versions) and then the least recently used
+    parked circuits while the budget is exceeded.
+-----------------------------------------------------------------------*/
+void admitcircuit(const char *name, const struct stat &st){
+    char path[PATH_MAX];
+    size_t j;
+
+    if(realpath(name, path) == NULL) snprintf(path, sizeof(path), "%s", name);
+    Current.path = path;
+    Current.mtime = st.st_mtim.tv_sec;
+    Current.mtimens = st.st_mtim.tv_nsec;
+    Current.lastuse = seconds();
+    for(j = Parked.size(); j-- > 0; )
+        if(Parked[j].path == Current.path) dropparked(j);     /* an older version of the file */
+    evict();
+}
+
+
+/*-----------------------------------------------------------------------
+input: circuit file name, its stat
+output: 0 if the file is the current or a parked circuit, now current;
+        -1 if it has to be read
+called by: cread
+description:
+    Looks the file up by real path. A parked circuit of the same mtime
+    is swapped in; one of another mtime, or one edited by ECO, is stale
+    and will be dropped by admitcircuit() once the file has been read
+    again.
+-----------------------------------------------------------------------*/
+int usecircuit(const char *name, const struct stat &st){
+    char path[PATH_MAX];
+    int i;
+
+    if(realpath(name, path) == NULL) return -1;
+    if(Gstate == CKTLD && Current.path == path) {
+        if(Eco.edits) return -1;
+        if(Current.mtime == (int64_t) st.st_mtim.tv_sec && Current.mtimens == (int64_t) st.st_mtim.tv_nsec) return 0;
+        return -1;
+    }
+    if((i = findckt(path)) < 0) return -1;
+    if(Parked[i].eco.edits || Parked[i].mtime != (int64_t) st.st_mtim.tv_sec || Parked[i].mtimens != (int64_t) st.st_mtim.tv_nsec) return -1;
+    parkcircuit();
+    swapckt(Parked[i]);
+    Parked.erase(Parked.begin() + i);
+    Current.lastuse = seconds();
+    return 0;
+}
+
+/* real path of the current circuit */
+const string &curcircuit(){
+    return Current.path;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    USE circuit makes a parked circuit current; circuit is its number in
+    LIST or its file name. The file is not looked at, so this is just a
+    swap of the globals.
+-----------------------------------------------------------------------*/
+void cuse(){
+    stringstream st(cp);
+    string arg;
+    char path[PATH_MAX];
+    double t0 = seconds();
+    int i;
+
+    st>>arg;
+    if(Gstate == CKTLD && realpath(arg.c_str(), path) && Current.path == path) {
+        printf("==> %s is current", path);
+        return;
+    }
+    if((i = findckt(arg)) < 0) {
+        printf("Error: %s is not a parked circuit, see LIST\n", arg.c_str());
+        return;
+    }
+    parkcircuit();
+    swapckt(Parked[i]);
+    Parked.erase(Parked.begin() + i);
+    Current.lastuse = seconds();
+    printf("==> %s, %d nodes, switched in %.1f us", Current.path.c_str(), Nnodes, (seconds() - t0) * 1e6);
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    LIST prints the current circuit (*) and the parked ones, most
+    recently used first, with their size in memory and the budget.
+-----------------------------------------------------------------------*/
+void clist(){
+    size_t total = cktbytes(), j, b;
+    double now = seconds();
+    vector< pair<double, int> > order;
+
+    if(Gstate == CKTLD) printf("  * %-40s %9d nodes %9.1f MB\n", Current.path.c_str(), Nnodes, cktbytes() / 1048576.0);
+    for(j = 0; j < Parked.size(); j++) order.push_back(make_pair(-Parked[j].lastuse, (int) j));
+    sort(order.begin(), order.end());
+    for(j = 0; j < order.size(); j++) {
+        cktstruc &c = Parked[order[j].second];
+
+        swapckt(c);
+        b = cktbytes();
+        swapckt(c);
+        total += b;
+        printf("%3d %-40s %9d nodes %9.1f MB  used %.0f s ago\n", order[j].second + 1, c.path.c_str(), c.nnodes,
+               b / 1048576.0, now - c.lastuse);
+    }
+    if(Budget) printf("==> %.1f MB of %.1f MB", total / 1048576.0, Budget / 1048576.0);
+    else printf("==> %.1f MB, no budget", total / 1048576.0);
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    DROP circuit frees a parked circuit, DROP -A all of them and DROP
+    with no argument the current one.
+-----------------------------------------------------------------------*/
+void cdrop(){
+    stringstream st(cp);
+    string arg;
+    int i;
+
+    if(!(st>>arg)) {
+        if(Gstate == CKTLD) printf("==> %s dropped", Current.path.c_str());
+        clear();
+        Current = cktstruc();
+        return;
+    }
+    if(arg == "-A" || arg == "-a") {
+        printf("==> %d parked circuit%s dropped", (int) Parked.size(), Parked.size() == 1 ? "" : "s");
+        while(!Parked.empty()) dropparked(Parked.size() - 1);
+        return;
+    }
+    if((i = findckt(arg)) < 0) {
+        printf("Error: %s is not a parked circuit, see LIST\n", arg.c_str());
+        return;
+    }
+    printf("==> %s dropped", Parked[i].path.c_str());
+    dropparked(i);
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    BUDGET [MB] sets or prints the memory budget of the circuits (0: no
+    limit), dropping least recently used parked circuits to meet it.
+-----------------------------------------------------------------------*/
+void cbudget(){
+    double mb;
+
+    if(sscanf(cp, "%lf", &mb) == 1 && mb >= 0) {
+        Budget = (size_t) (mb * 1048576.0);
+        evict();
+    }
+    if(Budget) printf("==> budget %.1f MB", Budget / 1048576.0);
+    else printf("==> no budget");
+}
+
+/*==========================Simulation Server=============================*/
+/*-----------------------------------------------------------------------
+SERVE keeps the process, and the circuits of the registry, alive across
+jobs. Clients (see simclient.cpp) connect to a Unix domain socket and
+send framed requests (see framehdr in readckt.h), each naming a circuit
+file and carrying vectors in the LOGICSIM input format. The server polls
+all connections, takes every complete request that has arrived and only
+then simulates: the requests for one circuit are packed into shared
+pattern-parallel passes, so a burst of small jobs costs about as many
+tape passes as one job of all their vectors. The sockets are
+non-blocking: replies are queued per connection, in request order, and
+sent as the client takes them, so a slow client holds up only itself.
+-----------------------------------------------------------------------*/
+struct reqstruc {
+    int fd;                    /* connection, -1 once it is closed */
+    uint32_t id;               /* request id, echoed in the reply */
+    string circuit;            /* real path of the circuit file */
+    string vec;                /* vectors */
+    string out;                /* PO lines of the reply */
+    int nvec;                  /* vectors simulated */
+    int nbad, badline;         /* malformed vector lines, see vecreader */
+};
+
+struct connstruc {
+    int fd;
+    string in;                 /* received bytes not yet taken as frames */
+    string out;                /* queued replies, sent up to outpos */
+    size_t outpos;
+};
+
+/* appends one frame, its header then the payload, to buf */
+static void putframe(string &buf, uint32_t type, uint32_t id, const char *data, size_t len){
+    struct framehdr h;
+
+    h.magic = FRAMEMAGIC;
+    h.type = type;
+    h.id = id;
+    h.len = len;
+    buf.append((const char *) &h, sizeof(h));
+    buf.append(data, len);
+}
+
+/*-----------------------------------------------------------------------
+input: socket, frame type, request id, payload
+output: 0 on success, -1 if the peer is gone
+called by: simclient
+description:
+    Sends one frame on a blocking socket: its header, then the payload.
+-----------------------------------------------------------------------*/
+int sendframe(int fd, uint32_t type, uint32_t id, const char *data, size_t len){
+    string buf;
+    size_t off = 0;
+    ssize_t n;
+
+    buf.reserve(sizeof(struct framehdr) + len);
+    putframe(buf, type, id, data, len);
+    while(off < buf.size()) {
+        if((n = send(fd, buf.data() + off, buf.size() - off, MSG_NOSIGNAL)) < 0 && errno == EINTR) continue;
+        if(n <= 0) return -1;
+        off += n;
+    }
+    return 0;
+}
+
+/* reads exactly n bytes; -1 at end of file or on error */
+static int readall(int fd, char *p, size_t n){
+    ssize_t k;
+
+    while(n > 0) {
+        if((k = read(fd, p, n)) < 0 && errno == EINTR) continue;
+        if(k <= 0) return -1;
+        p += k;
+        n -= k;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------
+input: socket, header and payload to fill
+output: 0 on success, -1 at end of file or on a malformed frame
+called by: simclient
+description:
+    Receives one frame, waiting for all of it.
+-----------------------------------------------------------------------*/
+int recvframe(int fd, struct framehdr &h, string &data){
+    if(readall(fd, (char *) &h, sizeof(h)) < 0) return -1;
+    if(h.magic != FRAMEMAGIC || h.len > MAXFRAME) return -1;
+    data.resize(h.len);
+    return h.len ? readall(fd, &data[0], h.len) : 0;
+}
+
+/* moves the complete frames of c to pending; -1 on a malformed frame,
+   1 after a FR_QUIT */
+static int takeframes(connstruc &c, vector<reqstruc> &pending){
+    char path[PATH_MAX];
+    struct framehdr h;
+    size_t pos = 0, nul;
+    reqstruc r;
+    int quit = 0;
+
+    while(c.in.size() - pos >= sizeof(h)) {
+        memcpy(&h, c.in.data() + pos, sizeof(h));
+        if(h.magic != FRAMEMAGIC || h.len > MAXFRAME) return -1;
+        if(c.in.size() - pos - sizeof(h) < h.len) break;
+        pos += sizeof(h);
+        if(h.type == FR_QUIT) {
+            putframe(c.out, FR_OK, h.id, "", 0);
+            quit = 1;
+        }
+        else if(h.type != FR_SIM || (nul = c.in.find('\0', pos)) == string::npos || nul >= pos + h.len) {
+            putframe(c.out, FR_ERR, h.id, "malformed request\n", 18);
+        }
+        else {
+            r.fd = c.fd;
+            r.id = h.id;
+            r.circuit.assign(c.in, pos, nul - pos);
+            if(realpath(r.circuit.c_str(), path)) r.circuit = path;
+            r.vec.assign(c.in, nul + 1, pos + h.len - nul - 1);
+            r.nvec = 0;
+            pending.push_back(r);
+        }
+        pos += h.len;
+    }
+    c.in.erase(0, pos);
+    return quit;
+}
+
+/* sends the queued replies of c as far as the socket takes them; -1 if
+   the peer is gone */
+static int sendqueued(connstruc &c){
+    ssize_t n;
+
+    while(c.outpos < c.out.size()) {
+        if((n = send(c.fd, c.out.data() + c.outpos, c.out.size() - c.outpos, MSG_NOSIGNAL)) < 0) {
+            if(errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        c.outpos += n;
+    }
+    c.out.clear();
+    c.outpos = 0;
+    return 0;
+}
+
+/* queues a reply to r, unless its connection has been closed */
+static void queuereply(vector<connstruc> &conn, const reqstruc &r, uint32_t type, const string &data){
+    size_t j;
+
+    for(j = 0; j < conn.size(); j++)
+        if(conn[j].fd >= 0 && conn[j].fd == r.fd) putframe(conn[j].out, type, r.id, data.data(), data.size());
 }
+
+/* makes name current through READ, which only swaps in a registered
+   circuit unless the file changed; -1 if it cannot be read */
+static int servecircuit(const string &name){
+    char line[MAXNAME];
+    int v = Verbose;
+
+    snprintf(line, sizeof(line), "%s\n", name.c_str());
+    cp = line;
+    Verbose = 0;
+    cread();
+    Verbose = v;
+    if(Gstate != CKTLD || name != curcircuit()) return -1;
+    if(Tapelev == NULL && compile() < 0) return -1;
+    if(!Nativedir.empty() && Native == NULL) loadnative(0);
+    return 0;
+}
+
+/* simulates the npat packed vectors of st and appends their PO lines,
+   "num," prefixes in pofix, to the requests they came from */
+static void serveblock(simstate &st, vector<reqstruc *> &owner, const vector<string> &pofix, int &npat){
+    int i, p;
+
+    for(i = 0; i < Npi; i++)
+        memcpy(&st.val[(size_t) Pinput[i]->indx * st.nw], &st.piword[(size_t) i * st.nw], st.nw * sizeof(uint64_t));
+    tapesimw(&st.val[0], st.nw);
+    for(p = 0; p < npat; p++) {
+        reqstruc *r = owner[p];
+
+        if(r->nvec++ > 0) r->out += '\n';
+        for(i = 0; i < Npo; i++) {
+            r->out += pofix[i];
+            r->out += '0' + st.bit(Poutput[i]->indx, p);
+            r->out += '\n';
+        }
+    }
+    st.piword.assign((size_t) Npi * st.nw, 0);
+    st.nvec += npat;
+    npat = 0;
+}
+
+/*-----------------------------------------------------------------------
+input: requests for the current circuit
+output: number of passes over the tape
+called by: serve
+description:
+    Packs the vectors of all the requests, back to back, into blocks of
+    64*nw patterns and simulates each block with one pass, as LOGICSIM
+    -P does. Every request starts with all its PIs at 0, as after READ,
+    and a PI missing from a vector keeps its value of the vector before.
+-----------------------------------------------------------------------*/
+static long long servebatch(vector<reqstruc *> &rq){
+    phasetimer timer(PH_LOGICSIM);
+    simstate st;
+    vecreader in;
+    size_t j;
+    long long npass = 0;
+    int i, npat = 0;
+
+    st.init(simdwords());
+    st.piword.assign((size_t) Npi * st.nw, 0);
+    vector<reqstruc *> owner(64 * st.nw);
+    vector<string> pofix(Npo);
+    for(i = 0; i < Npo; i++) {
+        putpo(pofix[i], Poutput[i]->num, 0);
+        pofix[i].resize(pofix[i].size() - 2);
+    }
+    for(j = 0; j < rq.size(); j++) {
+        reqstruc *r = rq[j];
+
+        in.openmem(r->vec.data(), r->vec.data() + r->vec.size(), 0);
+        st.pival.assign(Npi, 0);
+        while(in.next(st.pival)) {
+            for(i = 0; i < Npi; i++)
+                if(st.pival[i] > 0) st.piword[(size_t) i * st.nw + npat / 64] |= (uint64_t)1 << (npat % 64);
+            owner[npat++] = r;
+            if(npat == 64 * st.nw) {
+                serveblock(st, owner, pofix, npat);
+                npass++;
+            }
+        }
+        r->nbad = in.nbad;
+        r->badline = in.badline;
+        in.close();
+    }
+    if(npat > 0) {
+        serveblock(st, owner, pofix, npat);
+        npass++;
+    }
+    Stats.vectors += st.nvec;
+    return npass;
+}
+
+/*-----------------------------------------------------------------------
+input: nothing
+output: nothing
+called by: main
+description:
+    SERVE socket serves simulation requests on the Unix domain socket
+    until a client sends FR_QUIT (simclient -Q), then sends the replies
+    still queued, removes the socket and returns to the command prompt.
+    The settings made before (THREADS, SIMD, CODEGEN, BUDGET) apply to
+    the served simulations. A request with a malformed vector line gets
+    FR_ERR. Clients name the circuit files, so no cache is written while
+    serving, and the socket is created with mode 0700, so only the user
+    can connect. An existing file at the path is only replaced if it is
+    a socket.
+-----------------------------------------------------------------------*/
+void serve(){
+    stringstream st(cp);
+    string name;
+    struct sockaddr_un addr;
+    static char buf[1 << 20];
+    vector<connstruc> conn;
+    vector<struct pollfd> pfd;
+    vector<reqstruc> pending;
+    vector<reqstruc *> group;
+    long long nreq = 0, nvec = 0, npass = 0;
+    size_t j, k;
+    ssize_t n;
+    struct stat sb;
+    mode_t mask;
+    int lfd, fd, np, ok, stop = 0;
+
+    if(!(st>>name) || name.size() >= sizeof(addr.sun_path)) {
+        printf("Error: SERVE needs a socket path of at most %d characters\n", (int) sizeof(addr.sun_path) - 1);
+        return;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, name.c_str());
+    if(lstat(name.c_str(), &sb) == 0) {        //only a stale socket is replaced
+        if(!S_ISSOCK(sb.st_mode)) {
+            printf("Error: %s exists and is not a socket\n", name.c_str());
+            return;
+        }
+        unlink(name.c_str());
+    }
+    //Connecting needs write permission on the socket: the user's only
+    mask = umask(077);
+    ok = (lfd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 && bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+    umask(mask);
+    if(!ok || listen(lfd, 128) < 0) {
+        printf("Error: cannot listen on %s: %s\n", name.c_str(), strerror(errno));
+        if(lfd >= 0) close(lfd);
+        return;
+    }
+    VERB(1) { printf("==> serving on %s\n", name.c_str()); fflush(stdout); }
+    Nocache = 1;
+
+    while(1) {
+        pfd.resize(conn.size() + 1);
+        pfd[0].fd = lfd;
+        pfd[0].events = stop ? 0 : POLLIN;
+        for(j = 0, k = 0; j < conn.size(); j++) {
+            pfd[j + 1].fd = conn[j].fd;
+            pfd[j + 1].events = (stop ? 0 : POLLIN) | (conn[j].out.empty() ? 0 : POLLOUT);
+            if(!conn[j].out.empty()) k++;
+        }
+        if(stop && k == 0) break;
+        if((np = poll(&pfd[0], pfd.size(), stop ? DRAINWAIT : -1)) < 0) {
+            if(errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if(np == 0) break;          /* the clients left do not take their replies */
+        //Take every request that has arrived, then serve them together
+        for(j = 1; j < pfd.size(); j++) {
+            connstruc &c = conn[j - 1];
+            int r = 0, gone = 0;
+
+            if(pfd[j].revents & (POLLIN | POLLHUP | POLLERR)) {
+                while((n = read(c.fd, buf, sizeof(buf))) < 0 && errno == EINTR);
+                if(n > 0) {
+                    c.in.append(buf, n);
+                    r = takeframes(c, pending);
+                    if(r > 0) stop = 1;
+                }
+                else if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) gone = 1;
+            }
+            if(gone || r < 0) {
+                for(k = 0; k < pending.size(); k++)
+                    if(pending[k].fd == c.fd) pending[k].fd = -1;
+                close(c.fd);
+                c.fd = -1;
+            }
+        }
+        if(pfd[0].revents & POLLIN) {
+            connstruc c;
+
+            if((fd = accept(lfd, NULL, NULL)) >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                c.fd = fd;
+                c.outpos = 0;
+                conn.push_back(c);
+            }
+        }
+
+        //One batch per circuit, in the order of their first requests
+        for(j = 0; j < pending.size(); j++) {
+            if(pending[j].nvec < 0) continue;
+            group.clear();
+            for(k = j; k < pending.size(); k++)
+                if(pending[k].nvec >= 0 && pending[k].circuit == pending[j].circuit) group.push_back(&pending[k]);
+            if(servecircuit(pending[j].circuit) < 0) {
+                string msg = "cannot read circuit " + pending[j].circuit + "\n";
+
+                for(k = 0; k < group.size(); k++) {
+                    queuereply(conn, *group[k], FR_ERR, msg);
+                    group[k]->nvec = -1;
+                }
+                continue;
+            }
+            npass += servebatch(group);
+            for(k = 0; k < group.size(); k++) {
+                reqstruc &r = *group[k];
+
+                nvec += r.nvec;
+                if(r.nbad) {
+                    char msg[128];
+
+                    snprintf(msg, sizeof(msg), "line %d: malformed vector line, %d in all\n", r.badline, r.nbad);
+                    queuereply(conn, r, FR_ERR, msg);
+                }
+                else queuereply(conn, r, FR_OK, r.out);
+                r.nvec = -1;
+            }
+        }
+        nreq += pending.size();
+        pending.clear();
+
+        //Send what the sockets take, drop the connections that are gone
+        for(j = 0, k = 0; j < conn.size(); j++) {
+            if(conn[j].fd >= 0 && sendqueued(conn[j]) < 0) {
+                close(conn[j].fd);
+                conn[j].fd = -1;
+            }
+            if(conn[j].fd >= 0) swap(conn[k++], conn[j]);
+        }
+        conn.resize(k);
+    }
+    Nocache = 0;
+    for(j = 0; j < conn.size(); j++) close(conn[j].fd);
+    close(lfd);
+    unlink(name.c_str());
+    printf("==> %lld requests, %lld vectors in %lld passes", nreq, nvec, npass);
+}
+
 /*========================= End of program ============================*/
@@ -0,0 +1,316 @@
+/*=======================================================================
+  Data structures and routines of the "self" format circuit simulator.
+
+  The routines live in readckt.cpp and are built into the readckt
+  library, which is shared by the command interpreter (main.cpp), the
+  circuit generator (gencircuit.cpp) and the benchmark (bench.cpp). See
+  readckt.cpp for the circuit format and the command descriptions.
+=======================================================================*/
+#ifndef READCKT_H
+#define READCKT_H
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <ctype.h>
+#include <cstring>
+#include <stdlib.h>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define MAXLINE 10000               /* Input buffer size */
+#define MAXNAME 10000               /* File name size */
+
+#ifndef MAXVERBOSE
+#define MAXVERBOSE 2                /* highest verbosity compiled in, see VERB */
+#endif
+
+#define VALX -1                     /* value X (unknown) of a PI or node */
+
+#define PARCHUNK 256                /* tape ops per work item of the threaded simulator */
+#define PARMIN 1024                 /* smallest level split across the threads */
+#define RANDCHUNK 1024              /* tape ops evaluated, then counted, at a time by RANDSIM */
+#define MAXDELAY 65535              /* largest gate delay of LOGICSIM -T, in time steps */
+
+#define Upcase(x) ((isalpha(x) && islower(x))? toupper(x) : (x))
+#define Lowcase(x) ((isalpha(x) && isupper(x))? tolower(x) : (x))
+#define FILEIDX(i) (Fileorder ? Fileorder[i] : (i))   /* index of the i-th node of the file */
+
+enum e_com {READ, PC, HELP, QUIT,LEV,LOGICSIM,FAULTSIM,FCOLLAPSE,STATS,VERBOSE,THREADS,SIMD,CODEGEN,REORDER,USE,LIST,DROP,BUDGET,SERVE,RANDSIM,ECO};
+enum e_state {EXEC, CKTLD};         /* Gstate values */
+enum e_ntype {GATE, PI, FB, PO};    /* column 1 of circuit format */
+enum e_gtype {IPT, BRCH, XOR, OR, NOR, NOT, NAND, AND,XNOR, BUFFER};   /* gate types */
+enum e_isa {ISA_SCALAR, ISA_AVX2, ISA_AVX512, NISA};   /* gate kernels, see SIMD */
+enum e_order {ORD_LEVEL, ORD_DFS};     /* node orderings, see REORDER */
+enum e_phase {PH_READ, PH_LEV, PH_LOGICSIM, PH_FAULTSIM, PH_FCOLLAPSE, NPHASES};
+
+#define NUMFUNCS 21                 /* number of commands in command[] */
+
+struct cmdstruc {
+   char name[MAXNAME];        /* command syntax */
+   void (*fptr)();            /* function pointer of the commands */
+   enum e_state state;        /* execution state sequence */
+};
+
+typedef struct n_struc {
+    unsigned indx;             /* node index(from 0 to NumOfLine - 1 */
+    unsigned num;              /* line number(May be different from indx */
+    enum e_ntype ntype;
+    enum e_gtype type;         /* gate type */
+    unsigned fin;              /* number of fanins */
+    unsigned fout;             /* number of fanouts */
+    struct n_struc **unodes;   /* pointer to array of up nodes */
+    struct n_struc **dnodes;   /* pointer to array of down nodes */
+    int level;                 /* level of the gate output */
+	int value;				   /*value for each node*/
+} NSTRUC;
+
+/* One op of the compiled simulation tape: the gate type, the node index
+   whose value it writes and its fanin slots Tapefin[fin .. fin+nfin-1]. */
+typedef struct t_struc {
+    unsigned char op;          /* gate type */
+    uint32_t out;              /* output slot (node index) */
+    uint32_t fin;              /* first fanin slot in Tapefin */
+    uint32_t nfin;             /* number of fanins */
+} TSTRUC;
+
+/* A single stuck-at fault on the output line of a node. Branches are
+   nodes of their own (BRCH) in the self format, so this covers both
+   stems and fanout branches. */
+typedef struct f_struc {
+    uint32_t node;             /* faulty node index */
+    unsigned char sa;          /* stuck-at value, 0 or 1 */
+    int det;                   /* first detecting vector, -1 if undetected */
+} FSTRUC;
+
+/* Compressed-sparse-row topology of the circuit. The up (down) nodes of
+   node i are fanin[finoff[i]] .. fanin[finoff[i+1]-1] (likewise for
+   fanout), all as 32-bit node indices in contiguous arrays. It holds no
+   per-run values, so the simulators stream through it sequentially. */
+typedef struct c_struc {
+    uint32_t *finoff;          /* Nnodes+1 offsets into fanin */
+    uint32_t *fanin;           /* up node indices */
+    uint32_t *foutoff;         /* Nnodes+1 offsets into fanout */
+    uint32_t *fanout;          /* down node indices */
+    unsigned char *type;       /* gate type of each node */
+} CSTRUC;
+
+/* Instrumentation counters, printed by STATS. */
+struct statstruc {
+    double time[NPHASES];      /* seconds spent in each phase */
+    long long calls[NPHASES];  /* number of runs of each phase */
+    long long gateevals;       /* gate evaluations (one word each) */
+    long long vectors;         /* vectors simulated */
+    long long bytes;           /* bytes parsed from circuit and vector files */
+    long long allocs;          /* allocations of circuit data */
+    long long allocbytes;      /* bytes of those allocations */
+};
+
+/* Adds the lifetime of the object to the time of a phase in Stats. */
+struct phasetimer {
+    enum e_phase ph;
+    double t0;
+
+    phasetimer(enum e_phase p);
+    ~phasetimer();
+};
+
+/* Buffered reader of vector files. A vector is a block of "PI_ID,value"
+   lines and vectors are separated by blank lines, so a file holds any
+   number of vectors. The file is closed by close() or the destructor. */
+struct vecreader {
+    int fd;
+    char *buf;
+    size_t size, pos, len;
+    int eof, nline;
+    int nbad, badline;         /* malformed lines skipped, and the first of them */
+    int own;                   /* buf is allocated here, not a caller's text */
+
+    vecreader() : fd(-1), buf(NULL), size(0), pos(0), len(0), eof(1), nline(0), nbad(0), badline(0), own(0) {}
+    ~vecreader(){ close(); }
+    vecreader(const vecreader &) = delete;
+    vecreader &operator=(const vecreader &) = delete;
+    int open(const char *name);
+    void openmem(const char *s, const char *e, int line0);
+    void close();
+    int getline(const char *&s, const char *&e);
+    int next(std::vector<int> &pival);
+};
+
+/* Buffered writer for the simulation results, flushed and closed by
+   close() or the destructor. A failed write is remembered and close()
+   returns -1 with its errno, so the caller can report it. */
+struct vecwriter {
+    int fd;
+    char *buf;
+    size_t len;
+    int err;                   /* errno of the first failed write, 0 if none */
+    enum { SIZE = 1 << 20 };
+
+    vecwriter() : fd(-1), buf(NULL), len(0), err(0) {}
+    ~vecwriter(){ close(); }
+    vecwriter(const vecwriter &) = delete;
+    vecwriter &operator=(const vecwriter &) = delete;
+    int open(const char *name, int flags = O_TRUNC);
+    void flush();
+    int close();
+    void writeall(const char *s, size_t n);
+    void put(char c){
+        if(len == SIZE) flush();
+        buf[len++] = c;
+    }
+    void write(const char *s, size_t n);
+    void putint(long long v);
+    void poline(unsigned num, int value);
+};
+
+/* Per-run state of a simulation. The topology (Ckt, Tape) is read-only
+   while simulating and each run writes only to its own simstate, so
+   several runs can share one circuit, one per thread. */
+struct simstate {
+    int nw;                         /* 64-bit words per node, see simdwords() */
+    std::vector<uint64_t> val;      /* value block of every node, nw words each */
+    std::vector<int> pival;         /* PI values of the last vector, in Pinput order */
+    std::vector<uint64_t> piword;   /* packed PI values of the current block */
+    long long evals;                /* gate evaluations */
+    long long nvec;                 /* vectors simulated */
+
+    simstate() : nw(1), evals(0), nvec(0) {}
+    void init(int words);
+    /* value of node n in pattern p of the block */
+    int bit(uint32_t n, int p) const {
+        return (val[(size_t) n * nw + p / 64] >> (p % 64)) & 1;
+    }
+};
+
+/* Native simulator of the compiled tape, see CODEGEN: runs one pass over
+   a value array of nw words per node, returns -1 if nw is not supported. */
+typedef int (*nativefn)(uint64_t *val, int nw);
+
+/* Header of a frame of the SERVE protocol, followed by len payload bytes.
+   A FR_SIM request carries a circuit file name, a NUL and vectors in the
+   LOGICSIM input format; its FR_OK reply carries the PO lines LOGICSIM
+   writes for them, FR_ERR a message. FR_QUIT stops the server. */
+#define FRAMEMAGIC 0x544b4352       /* "RCKT" */
+#define MAXFRAME (1u << 30)         /* largest payload */
+#define DRAINWAIT 10000             /* ms SERVE waits at FR_QUIT for clients to take replies */
+enum e_frame {FR_SIM, FR_QUIT, FR_OK, FR_ERR};
+
+struct framehdr {
+    uint32_t magic;            /* FRAMEMAGIC */
+    uint32_t type;             /* e_frame */
+    uint32_t id;               /* request id, echoed in the reply */
+    uint32_t len;              /* payload bytes */
+};
+
+/* VERB(l) statement; runs the statement only at verbosity l or more. Levels
+   above MAXVERBOSE are compiled out, e.g. -DMAXVERBOSE=1 for production. */
+#define VERB(l) if((l) > MAXVERBOSE || (l) > Verbose) ; else
+
+/*------------------------------------------------------------------------*/
+extern struct cmdstruc command[NUMFUNCS];
+extern const char *phasename[NPHASES];
+extern struct statstruc Stats;
+extern int Verbose;
+extern enum e_state Gstate;
+extern NSTRUC *Node;
+extern NSTRUC **Pinput;
+extern NSTRUC **Poutput;
+extern uint64_t *Pvalue;
+extern int Nlevels;
+extern int *Levstart;
+extern int *Levnode;
+extern TSTRUC *Tape;
+extern uint32_t *Tapefin;
+extern int Ntape;
+extern int *Tapelev;
+extern int Nphase;
+extern int *Phasestart;
+extern unsigned char *Phasepar;
+extern int Nthreads;
+extern nativefn Native;
+extern std::string Nativedir;
+extern int Simd;
+extern const char *isaname[NISA];
+extern CSTRUC Ckt;
+extern int *Pislot;
+extern int Npislot;
+extern int *Fileorder;
+extern int Nnodes;
+extern int Nedges;
+extern int Npi;
+extern int Npo;
+extern int Done;
+extern char *cp;
+extern std::string inputFilename;
+extern std::string outputFilename;
+
+/*----------------- Commands ---------------------------------------------*/
+void cread(), pc(), help(), quit(),lev(),logicsim(),faultsim(),fcollapse(),stats(),verbose(),threads(),simd(),codegen(),reorder(),
+     cuse(),clist(),cdrop(),cbudget(),serve(),randsim(),eco();
+
+/*----------------- Routines ---------------------------------------------*/
+std::string gname(int tp);
+double seconds();
+void *cmalloc(size_t size);
+void *ccalloc(size_t n, size_t size);
+long peakmemory();
+void clear();
+void allocate(int csr = 1);
+void linknodes();
+void freeckt();
+int loadcache(const char *name, const struct stat &src);
+int savecache(const char *name, const struct stat &src, int levels);
+void cachelevels();
+void parkcircuit();
+void admitcircuit(const char *name, const struct stat &st);
+int usecircuit(const char *name, const struct stat &st);
+const std::string &curcircuit();
+int levelize();
+int compile();
+int renumber(int how);
+void tapesim(uint64_t *val);
+void tapesimw(uint64_t *val, int nw);
+void tapesim3(uint64_t *val, int nw);
+int setsimd(int isa);
+int simdwords();
+long kernelcheck(int isa);
+bool gatefunction(enum e_gtype type, std::vector<bool> inputvalue);
+int setthreads(int n);
+uint64_t tapehash();
+int loadnative(int force);
+void freenative();
+uint64_t evalnode(uint32_t n, const uint64_t *val);
+int readfile();
+void circuit_value_calculation();
+void outfilewriting(int nvec);
+void logicsim_parallel(const std::string &infile, const std::string &outfile);
+void logicsim_event(const std::string &infile, const std::string &outfile);
+void logicsim_timed(const std::string &delayfile, const std::string &infile, const std::string &outfile,
+                    const std::string &trfile);
+int readblock(vecreader &in, std::vector<int> &pival, std::vector<uint64_t> &piword, int nw = 1);
+void logicsim_shard(const std::string &infile, const std::string &outfile);
+int readblock3(vecreader &in, std::vector<int> &pival, std::vector<uint64_t> &piword, int nw);
+void logicsim3(const std::string &infile, const std::string &outfile);
+void logicsim_misr(long long window, const std::string &infile, const std::string &sigfile, const std::string &golden);
+void logicsim_window(long long w, const std::string &sigfile, const std::string &infile, const std::string &outfile);
+void freecones();
+void freeeco();
+void ecosync();
+void faultlist(std::vector<FSTRUC> &flist);
+int readfaults(const char *name, std::vector<FSTRUC> &flist);
+void collapse(std::vector<FSTRUC> &flist);
+int sendframe(int fd, uint32_t type, uint32_t id, const char *data, size_t len);
+int recvframe(int fd, struct framehdr &h, std::string &data);
+
+#endif
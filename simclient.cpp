@@ -0,0 +1,146 @@
+/*=======================================================================
+  simclient - client of the simulation server (see SERVE)
+
+  usage: simclient -s socket [-n requests] [-j clients] circuit infile outfile
+         simclient -s socket -Q
+
+  Sends the vectors of infile for the circuit file to the server on the
+  Unix domain socket and writes the PO lines of the reply to outfile, as
+  LOGICSIM infile outfile would after READ circuit. -Q stops the server.
+
+  To measure the server, -j runs the given number of clients at once on
+  their own connections, each sending the request -n times, one after
+  the other; the requests of different clients are batched together by
+  the server. A summary line of the request latencies and throughput is
+  then printed to stderr.
+=======================================================================*/
+#include "readckt.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <limits.h>
+#include <thread>
+
+using namespace std;
+
+static void usage(){
+    fprintf(stderr, "usage: simclient -s socket [-n requests] [-j clients] circuit infile outfile\n");
+    fprintf(stderr, "       simclient -s socket -Q\n");
+    exit(1);
+}
+
+/* connects to the server; -1 on failure */
+static int connectserver(const char *name){
+    struct sockaddr_un addr;
+    int fd;
+
+    if(strlen(name) >= sizeof(addr.sun_path)) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, name);
+    if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return -1;
+    if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* one client: n requests of the same payload, latencies in lat */
+static void runclient(const char *sock, const string *req, int n, vector<double> *lat, string *reply, int *bad){
+    struct framehdr h;
+    double t0;
+    int fd, i;
+
+    if((fd = connectserver(sock)) < 0) {
+        *bad = 1;
+        return;
+    }
+    for(i = 0; i < n; i++) {
+        t0 = seconds();
+        if(sendframe(fd, FR_SIM, i, req->data(), req->size()) < 0 || recvframe(fd, h, *reply) < 0) {
+            *bad = 1;
+            break;
+        }
+        lat->push_back(seconds() - t0);
+        if(h.type != FR_OK) {
+            fprintf(stderr, "Error: %s", reply->c_str());
+            *bad = 1;
+            break;
+        }
+    }
+    close(fd);
+}
+
+int main(int argc, char **argv){
+    const char *sock = NULL;
+    int c, n = 1, nclient = 1, quit = 0, fd, i, bad = 0;
+    struct framehdr h;
+    string req, reply;
+    char buf[1 << 16], path[PATH_MAX];
+    ssize_t k;
+
+    while((c = getopt(argc, argv, "s:n:j:Q")) != -1) {
+        switch(c) {
+            case 's': sock = optarg; break;
+            case 'n': n = atoi(optarg); break;
+            case 'j': nclient = atoi(optarg); break;
+            case 'Q': quit = 1; break;
+            default: usage();
+        }
+    }
+    if(sock == NULL || n < 1 || nclient < 1 || (quit ? optind != argc : optind + 3 != argc)) usage();
+
+    if(quit) {
+        if((fd = connectserver(sock)) < 0 || sendframe(fd, FR_QUIT, 0, "", 0) < 0 || recvframe(fd, h, reply) < 0) {
+            fprintf(stderr, "Error: no server on %s\n", sock);
+            return 1;
+        }
+        close(fd);
+        return 0;
+    }
+
+    //The request is the circuit name, a NUL and the vector file as is;
+    //the name is made absolute, the server may run elsewhere
+    req.assign(realpath(argv[optind], path) ? path : argv[optind]);
+    req += '\0';
+    if((fd = open(argv[optind + 1], O_RDONLY)) < 0) {
+        fprintf(stderr, "Error: cannot read %s\n", argv[optind + 1]);
+        return 1;
+    }
+    while((k = read(fd, buf, sizeof(buf))) > 0) req.append(buf, k);
+    close(fd);
+
+    vector< vector<double> > lat(nclient);
+    vector<string> rep(nclient);
+    vector<int> fail(nclient, 0);
+    vector<thread> thr;
+    double t0 = seconds(), t;
+    for(i = 1; i < nclient; i++) thr.push_back(thread(runclient, sock, &req, n, &lat[i], &rep[i], &fail[i]));
+    runclient(sock, &req, n, &lat[0], &rep[0], &fail[0]);
+    for(i = 0; i < (int) thr.size(); i++) thr[i].join();
+    t = seconds() - t0;
+    for(i = 0; i < nclient; i++) bad |= fail[i];
+    if(bad) {
+        fprintf(stderr, "Error: request to the server on %s failed\n", sock);
+        return 1;
+    }
+
+    if((fd = open(argv[optind + 2], O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0 ||
+       write(fd, rep[0].data(), rep[0].size()) != (ssize_t) rep[0].size()) {
+        fprintf(stderr, "Error: cannot write %s\n", argv[optind + 2]);
+        return 1;
+    }
+    close(fd);
+
+    if(n * nclient > 1) {
+        vector<double> all;
+        for(i = 0; i < nclient; i++) all.insert(all.end(), lat[i].begin(), lat[i].end());
+        sort(all.begin(), all.end());
+        double sum = 0;
+        for(i = 0; i < (int) all.size(); i++) sum += all[i];
+        fprintf(stderr, "==> %d requests by %d clients in %.3f s: %.0f requests/s, latency mean %.1f us, p50 %.1f us, p99 %.1f us\n",
+                (int) all.size(), nclient, t, all.size() / t, sum / all.size() * 1e6,
+                all[all.size() / 2] * 1e6, all[(all.size() * 99) / 100] * 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#!/bin/sh
+#=======================================================================
+#  simtest.sh - regression tests of sim, run by ctest
+#
+#  usage: simtest.sh test sim gencircuit srcdir
+#
+#  Every test runs on c17 (tests/c17.ckt, all 32 vectors) and on a
+#  generated netlist with random vectors, in a directory of its own
+#  under the current one. The serial levelized LOGICSIM is the
+#  reference: LOGICSIM -P must match it and every other mode must match
+#  -P, so a difference points at the mode that changed.
+#
+#    modes    -P, -E, -S, -X, -O, -T, -M/-W against the reference
+#    reorder  REORDER level and dfs
+#    native   CODEGEN (skipped without a C compiler)
+#    fault    FCOLLAPSE and FAULTSIM, threads and orderings
+#    eco      ECO edits against READ of the edited netlist
+#    cache    READ of the .rcb cache, levelized, stale and corrupted
+#=======================================================================
+test=$1 sim=$2 gen=$3 src=$4
+dir=$PWD/simtest_$test
+
+fail(){
+    echo "FAIL: $*"
+    exit 1
+}
+
+# same a b: the files a and b are equal
+same(){
+    cmp -s "$1" "$2" || fail "$test: $1 differs from $2"
+}
+
+# run name: runs the commands of name.cmd into name.log, fails on an
+# error message
+run(){
+    "$sim" < "$1.cmd" > "$1.log" 2>&1 || fail "$test: sim exited with $?, see $dir/$1.log"
+    ! grep -q "Error\|ERROR" "$1.log" || fail "$test: $(grep -m1 "Error\|ERROR" "$1.log"), see $dir/$1.log"
+}
+
+# vectors file: one vector per line of random PI values of the netlist
+vectors(){
+    awk '$1 == 1 {print $2}' "$1" | awk -v n=200 '{pi[NR] = $1}
+        END {srand(1); for(v = 0; v < n; v++) {if(v) print ""; for(i = 1; i <= NR; i++) print pi[i] "," int(rand() * 2)}}' > "$2"
+}
+
+rm -rf "$dir"
+mkdir -p "$dir" && cd "$dir" || fail "cannot create $dir"
+cp "$src/c17.ckt" c17.ckt
+awk 'BEGIN {for(v = 0; v < 32; v++) {if(v) print ""; split("1 2 3 6 7", pi, " ");
+            for(i = 1; i <= 5; i++) print pi[i] "," int(v / 2 ^ (i - 1)) % 2}}' > c17.vec
+"$gen" -n 3000 -i 40 -s 7 -o gen.ckt > /dev/null || fail "gencircuit"
+vectors gen.ckt gen.vec
+
+for c in c17 gen; do
+    case $test in
+    modes)
+        pos=$(awk '$1 == 3 {print $2}' $c.ckt | head -2 | paste -sd, -)
+        awk 'BEGIN {RS = ""; ORS = "\n\n"} NR >= 9 && NR <= 16' $c.vec > $c.w.vec
+        printf "READ $c.ckt\nLOGICSIM $c.vec $c.ref\nLOGICSIM -P $c.vec $c.p\nLOGICSIM -E $c.vec $c.e\n\
+THREADS 2\nLOGICSIM -S $c.vec $c.s\nTHREADS 1\nLOGICSIM -X $c.vec $c.x\nLOGICSIM -O $pos -P $c.vec $c.o\n\
+LOGICSIM -T $c.vec $c.t $c.tr\nLOGICSIM -M 8 $c.vec $c.m\nLOGICSIM -M 8 $c.vec $c.m2 $c.m\n\
+LOGICSIM -W 1 $c.m $c.vec $c.w\nLOGICSIM -P $c.w.vec $c.wp\nLOGICSIM -M 8 $c.w.vec $c.m3 $c.m\nQUIT\n" > $c.cmd
+        run $c
+        same $c.p $c.ref
+        for m in e s x t; do same $c.$m $c.p; done
+        awk -F, -v l=",$pos," '$0 == "" || index(l, "," $1 ",")' $c.p > $c.op
+        same $c.o $c.op
+        same $c.w $c.wp
+        grep -q "==> $c.m matches, all windows" $c.log || fail "$test: $c: -M does not match its own signatures"
+        grep -q "==> mismatch: $c.m has" $c.log || fail "$test: $c: -M misses a different run"
+        ;;
+    reorder)
+        printf "READ $c.ckt\nLOGICSIM -P $c.vec $c.p\nREORDER level\nLOGICSIM -P $c.vec $c.l\nLOGICSIM -E $c.vec $c.le\n\
+REORDER dfs\nLOGICSIM -P $c.vec $c.d\nTHREADS 2\nLOGICSIM -S $c.vec $c.ds\nQUIT\n" > $c.cmd
+        run $c
+        for m in l le d ds; do same $c.$m $c.p; done
+        ;;
+    native)
+        command -v "${CC:-cc}" > /dev/null || { echo "no C compiler, skipped"; exit 77; }
+        XDG_CACHE_HOME=$dir/cache; export XDG_CACHE_HOME
+        printf "READ $c.ckt\nLOGICSIM -P $c.vec $c.p\nCODEGEN\nLOGICSIM -P $c.vec $c.n\nTHREADS 2\n\
+LOGICSIM -S $c.vec $c.ns\nREORDER dfs\nCODEGEN\nLOGICSIM -P $c.vec $c.nd\nQUIT\n" > $c.cmd
+        run $c
+        for m in n ns nd; do same $c.$m $c.p; done
+        ;;
+    fault)
+        printf "READ $c.ckt\nFCOLLAPSE $c.fc\nFAULTSIM $c.vec $c.f\nFAULTSIM $c.vec $c.fl $c.fc\nTHREADS 2\n\
+FAULTSIM $c.vec $c.f2\nTHREADS 1\nREORDER dfs\nFAULTSIM $c.vec $c.fd\nQUIT\n" > $c.cmd
+        run $c
+        same $c.f2 $c.f
+        same $c.fd $c.f
+        if [ $c = c17 ]; then       # c17 is fully testable, the 32 vectors detect every fault
+            grep -q "==> 30 faults, 30 detected" $c.log || fail "$test: c17 FAULTSIM coverage"
+            grep -q "==> 14 faults, 14 detected" $c.log || fail "$test: c17 FAULTSIM of the collapsed list"
+        fi
+        ;;
+    eco)
+        # two gates of two or more fanins change type, one fanin is added and deleted again
+        awk '$1 == 0 && $3 >= 2 && $5 >= 2 {print $2, $3}' $c.ckt | head -2 > $c.g
+        set -- $(cat $c.g)
+        g1=$1 t1=$(( $2 == 2 ? 4 : 2 )) g2=$3 t2=$(( $4 == 7 ? 3 : 7 ))
+        awk -v g1=$g1 -v t1=$t1 -v g2=$g2 -v t2=$t2 '$1 != 1 && $2 == g1 {$3 = t1} $1 != 1 && $2 == g2 {$3 = t2} {print}' \
+            $c.ckt > $c.e.ckt
+        pi=$(awk '$1 == 1 {print $2; exit}' $c.ckt)
+        printf "READ $c.ckt\nLOGICSIM -P $c.vec $c.p0\nECO TYPE $g1 $t1\nECO ADD $g2 $pi\nECO TYPE $g2 $t2\n\
+ECO DEL $g2 $pi\nLOGICSIM -P $c.vec $c.p\nLOGICSIM $c.vec $c.s\nREAD $c.e.ckt\nLOGICSIM -P $c.vec $c.ref\nQUIT\n" > $c.cmd
+        run $c
+        same $c.p $c.ref
+        same $c.s $c.ref
+        ! cmp -s $c.p0 $c.ref || [ $c = c17 ] || fail "$test: $c: the edits change no output"
+        ;;
+    cache)
+        rm -f $c.ckt.rcb
+        printf "READ $c.ckt\nLOGICSIM -P $c.vec $c.p\nQUIT\n" > $c.1.cmd
+        run $c.1
+        [ -f $c.ckt.rcb ] || fail "$test: $c: READ wrote no cache"
+        printf "VERBOSE 2\nREAD $c.ckt\nLOGICSIM -P $c.vec $c.p2\nLEV $c.lev\nQUIT\n" > $c.2.cmd
+        run $c.2
+        grep -q "mapped" $c.2.log || fail "$test: $c: READ did not map the cache"
+        printf "VERBOSE 2\nREAD $c.ckt\nLOGICSIM -P $c.vec $c.p3\nQUIT\n" > $c.3.cmd
+        run $c.3
+        grep -q "mapped.*levelized" $c.3.log || fail "$test: $c: the cache has no levels after LEV"
+        size=$(wc -c < $c.ckt.rcb)
+        head -c $((size / 2)) $c.ckt.rcb > $c.cut && mv $c.cut $c.ckt.rcb
+        printf "VERBOSE 2\nREAD $c.ckt\nLOGICSIM -P $c.vec $c.p4\nQUIT\n" > $c.4.cmd
+        run $c.4
+        ! grep -q "mapped" $c.4.log || fail "$test: $c: READ mapped a truncated cache"
+        sleep 1; touch $c.ckt
+        printf "VERBOSE 2\nREAD $c.ckt\nLOGICSIM -P $c.vec $c.p5\nQUIT\n" > $c.5.cmd
+        run $c.5
+        ! grep -q "mapped" $c.5.log || fail "$test: $c: READ mapped the cache of a changed file"
+        for m in p2 p3 p4 p5; do same $c.$m $c.p; done
+        ;;
+    *)
+        fail "unknown test $test"
+        ;;
+    esac
+done
+echo "$test: OK"